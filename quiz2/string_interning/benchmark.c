@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
+#include <time.h>
 
 #include "cstr.h"
 #include "unsigned.h"
@@ -10,39 +12,140 @@ typedef struct __data {
     cstring str;
 } data;
 
-// void* insert_cstr(void *__input){
-//     char buffer[12] = {0};
-//     data* input = (data*) __input;
-//     unsigned_string(buffer, input->val);
-//     input->str = cstr_clone(buffer, strlen(buffer));
-// }
+/* keys per thread count in the multi-threaded run, each count gets keys of
+ * its own so that every run starts with inserts
+ */
+#define MT_COUNT 400000
+#define MT_MAX_THREADS 8
 
+typedef struct __worker {
+    uint32_t base, lo, hi;
+    cstring *str;
+} worker;
+
+/* every thread interns its own slice of new keys */
+static void *insert_cstr(void *__input)
+{
+    worker *w = (worker *) __input;
+    char buffer[12] = {0};
+    for (uint32_t i = w->lo; i < w->hi; ++i) {
+        unsigned_string(buffer, w->base + i);
+        w->str[i] = cstr_clone(buffer, strlen(buffer));
+    }
+    return NULL;
+}
+
+/* every thread looks up all of the keys, which are interned by now */
+static void *lookup_cstr(void *__input)
+{
+    worker *w = (worker *) __input;
+    char buffer[12] = {0};
+    for (uint32_t i = 0; i < MT_COUNT; ++i) {
+        uint32_t k = (w->lo + i) % MT_COUNT;
+        unsigned_string(buffer, w->base + k);
+        cstring s = cstr_clone(buffer, strlen(buffer));
+        if (s != w->str[k])
+            abort();
+    }
+    return NULL;
+}
+
+static double seconds(struct timespec *start, struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) +
+           (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static uint64_t nanoseconds(struct timespec *t)
+{
+    return t->tv_sec * 1000000000ULL + t->tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+/* sorts latency */
+static void print_latency(uint64_t *latency, size_t count)
+{
+    qsort(latency, count, sizeof(uint64_t), cmp_u64);
+    printf("Insert latency (ns): p50 %lu p99 %lu p999 %lu p9999 %lu "
+           "max %lu\n",
+           latency[count / 2], latency[count * 99 / 100],
+           latency[count * 999 / 1000], latency[count * 9999 / 10000],
+           latency[count - 1]);
+}
+
+static double run_threads(void *(*f)(void *), worker *w, int n)
+{
+    pthread_t threads[MT_MAX_THREADS];
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int t = 0; t < n; ++t)
+        pthread_create(&threads[t], NULL, f, &w[t]);
+    for (int t = 0; t < n; ++t)
+        pthread_join(threads[t], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return seconds(&start, &end);
+}
+
+static void bench_threads(uint32_t base)
+{
+    cstring *str = (cstring *) malloc(sizeof(cstring) * MT_COUNT);
+    worker w[MT_MAX_THREADS];
+
+    printf("# threads insert(Mops/s) lookup(Mops/s)\n");
+    for (int n = 1; n <= MT_MAX_THREADS; n *= 2, base += MT_COUNT) {
+        for (int t = 0; t < n; ++t) {
+            w[t].base = base;
+            w[t].lo = (uint64_t) MT_COUNT * t / n;
+            w[t].hi = (uint64_t) MT_COUNT * (t + 1) / n;
+            w[t].str = str;
+        }
+        double t_insert = run_threads(insert_cstr, w, n);
+        double t_lookup = run_threads(lookup_cstr, w, n);
+        printf("%d %.2f %.2f\n", n, MT_COUNT / t_insert / 1e6,
+               (double) MT_COUNT * n / t_lookup / 1e6);
+    }
+    free(str);
+}
 
 int main(int argc, char *argv[])
 {
     size_t count = 5000000;
-    // pthread_t* threads = (pthread_t *) malloc(sizeof(pthread_t) * count);
     data* ret = (data *) malloc(sizeof(data) * count);
+    uint64_t *latency = (uint64_t *) malloc(sizeof(uint64_t) * count);
+    struct timespec start, end, t0, t1;
 
-    // for (uint32_t i=0;i<count;++i){
-    //     ret[i].val = i;
-    //     pthread_create(&threads[i], NULL, insert_cstr, (void*) &ret[i]);
-    // }
-
-    // for (uint32_t i=0;i<count;++i){
-    //     pthread_join(threads[i], NULL);
-    // }
-
+    /* from an empty table, so every shard goes through a dozen doublings */
+    clock_gettime(CLOCK_MONOTONIC, &start);
     for (uint32_t i=0;i<count;++i){
         char buffer[12] = {0};
         data* input = (data*) &ret[i];
         unsigned_string(buffer, i);
+        clock_gettime(CLOCK_MONOTONIC, &t0);
         input->str = cstr_clone(buffer, strlen(buffer));
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        latency[i] = nanoseconds(&t1) - nanoseconds(&t0);
     }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double t_insert = seconds(&start, &end);
 
     char buffer[12] = {0};
     size_t string_bytes = 0;
 
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t i=0;i<count;++i){
+        unsigned_string(buffer, i);
+        if (cstr_clone(buffer, strlen(buffer)) != ret[i].str)
+            abort();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double t_lookup = seconds(&start, &end);
+
     for (uint32_t i=0;i<count;++i){
         cstring expected = ret[i].str;
         unsigned_string(buffer, i);
@@ -59,7 +162,13 @@ int main(int argc, char *argv[])
 
     printf("Interned %lu unique strings\n", count);
     printf("Overhead per string: %.1f bytes\n", overhead_per_string);
+    printf("Insert: %.2f Mops/s, lookup: %.2f Mops/s\n",
+           count / t_insert / 1e6, count / t_lookup / 1e6);
+    print_latency(latency, count);
+
+    bench_threads(count);
 
+    free(latency);
     free(ret);
     return 0;
-}
\ No newline at end of file
+}
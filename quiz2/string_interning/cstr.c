@@ -1,46 +1,252 @@
 #include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef CSTR_RECLAIM
+#include <pthread.h>
+#endif
 
 #include "cstr.h"
+#include "hash.h"
 
-#define INTERNING_POOL_SIZE 1 << 23
-
-#define HASH_START_SIZE 16 /* must be power of 2 */
+/* The interned strings are split by hash into independent shards, each
+ * with its own table and insert lock. Lookups take no lock: nodes are
+ * published with a release store once they are complete and never change
+ * afterwards. A lookup racing with an insert may miss a string, which is
+ * then looked up again under the lock before anything is inserted.
+ *
+ * Built with CSTR_RECLAIM, interned strings are counted references: each
+ * cstr_clone or cstr_grab of one takes a reference that cstr_release
+ * drops, and the last one removes the string from its table. Lookups then
+ * run inside an epoch (see below) and take their reference with a
+ * compare-and-swap that fails on a dying node, leaving it to the locked
+ * path, which may bring it back.
+ */
+#define CSTR_SHARD_BITS 6
+#define CSTR_SHARDS (1 << CSTR_SHARD_BITS)
+#define CSTR_CACHE_LINE 64
 
+/* Just the string and its header, 8-byte aligned in the pool */
 struct __cstr_node
 {
-    char buffer[CSTR_INTERNING_SIZE];
     struct __cstr_data str;
-    struct __cstr_node *next;
+    uint32_t size;
+#ifdef CSTR_RECLAIM
+    atomic_uint ref;
+#endif
+    char buffer[];
+};
+
+#define CSTR_NODE_ALIGN 8
+#define CSTR_NODE_BYTES(sz)                                               \
+    ((sizeof(struct __cstr_node) + (sz) + 1 + CSTR_NODE_ALIGN - 1) &     \
+     ~(size_t)(CSTR_NODE_ALIGN - 1))
+#define CSTR_NODE_CLASSES (CSTR_NODE_BYTES(CSTR_INTERNING_SIZE) / CSTR_NODE_ALIGN)
+
+/* Nodes come from a chunked arena per shard. Chunks are mapped as they
+ * are needed, from CSTR_CHUNK_MIN bytes doubling up to CSTR_CHUNK_MAX, and
+ * never move or go away, so node addresses are stable. Building with
+ * CSTR_HUGE_PAGES asks for transparent huge pages on the largest chunks.
+ * Reclaimed nodes are kept on free lists by size and handed out first.
+ */
+#define CSTR_CHUNK_MIN (64 << 10)
+#define CSTR_CHUNK_MAX (2 << 20)
+
+struct __cstr_chunk
+{
+    struct __cstr_chunk *prev;
+    size_t size;
+    char data[];
 };
 
 struct __cstr_pool
 {
-    struct __cstr_node node[INTERNING_POOL_SIZE];
+    struct __cstr_chunk *chunk;
+    char *next, *end;
+    size_t used, mapped;
+#ifdef CSTR_RECLAIM
+    struct __cstr_node *free[CSTR_NODE_CLASSES];
+#endif
 };
 
-struct __cstr_interning
+/* The index is an open addressing table in the style of Abseil's Swiss
+ * table: a control byte per slot holds 7 bits of the node's spread hash
+ * with the high bit set, CSTR_EMPTY or CSTR_DELETED. Slots are probed a
+ * group of 16 at a time, comparing the 16 control bytes with one SSE2
+ * compare, and only nodes whose tag matches are looked at. Groups are
+ * probed in triangular order; a group with an empty slot ends the probe,
+ * which removed nodes leave as deleted to go on. An empty table is all
+ * zero and is taken from calloc as is.
+ *
+ * Growing is incremental: the doubled table takes all inserts at once,
+ * while the nodes of the old one are moved over CSTR_MIGRATE_NODES per
+ * insert, each costing a read of the node for its hash. The old table holds
+ * as many nodes as inserts it takes to fill the new one, so one per insert
+ * would do. Until the move is over, lookups check both tables. A table
+ * full of deleted slots is moved the same way into one of the same size.
+ */
+#define CSTR_GROUP 16
+#define CSTR_EMPTY 0
+#define CSTR_DELETED 1
+#define CSTR_FULL(ctrl) ((ctrl) & 0x80)
+#define CSTR_MIN_GROUPS 1 /* must be power of 2 */
+#define CSTR_MIGRATE_NODES 2
+
+/* The control bytes of a group sit right before its slots, so that a
+ * lookup usually reads both from the same cache line.
+ */
+struct __cstr_group
+{
+    uint8_t ctrl[CSTR_GROUP];
+    _Atomic(struct __cstr_node *) slot[CSTR_GROUP];
+};
+
+struct __cstr_table
+{
+    unsigned groups, deleted;
+    /* the most groups any node was placed past its first one */
+    unsigned max_probe;
+    /* the table being moved into this one, and its slots moved so far */
+    _Atomic(struct __cstr_table *) old;
+    atomic_size_t migrated;
+    /* next in the list of retired tables */
+    struct __cstr_table *retired;
+    struct __cstr_group *group;
+};
+
+/* Epoch based reclamation. A lookup announces the global epoch in its
+ * thread's record while it runs. The epoch moves on once every running
+ * lookup has announced it, so whatever was unlinked two epochs ago can no
+ * longer be seen by anyone. Unlinked nodes and tables wait in one of three
+ * limbo lists per shard, by epoch, until then.
+ */
+#ifdef CSTR_RECLAIM
+#define CSTR_LIMBO 3
+/* retirements between attempts at moving the epoch on */
+#define CSTR_RECLAIM_BATCH 64
+
+struct __cstr_thread
+{
+    _Alignas(CSTR_CACHE_LINE) atomic_ulong epoch; /* 0 when not in a lookup */
+    atomic_int in_use;
+    struct __cstr_thread *next;
+};
+
+struct __cstr_limbo
 {
-    int lock;
-    int index;
-    unsigned size;
+    unsigned long epoch;
+    struct __cstr_node *nodes;
+    struct __cstr_table *tables;
+};
+#endif
+
+struct __cstr_shard
+{
+    _Alignas(CSTR_CACHE_LINE) atomic_int lock;
     unsigned total;
-    struct __cstr_node **hash;
-    struct __cstr_pool *pool;
+    _Atomic(struct __cstr_table *) table;
+    /* Fully migrated tables: lookups may still be reading them, so they are
+     * kept instead of freed. All of them together take less memory than
+     * the live table.
+     */
+    struct __cstr_table *retired;
+    struct __cstr_pool pool;
+#ifdef CSTR_RECLAIM
+    struct __cstr_limbo limbo[CSTR_LIMBO];
+    unsigned retiring;
+#endif
 };
 
-static struct __cstr_interning __cstr_ctx;
+/* A snapshot is a file of interned strings that a process maps read-only
+ * as a base layer: lookups check it before the shards, which then only hold
+ * the strings it lacks. It is laid out as
+ *
+ *   header  magic, checks for the hash and node layout, and offsets
+ *   index   a table of groups as above, with 32-bit slots holding node
+ *           offsets from the start of the file in units of CSTR_NODE_ALIGN
+ *   nodes   one struct __cstr_snap_node per string
+ *
+ * in host byte order. Only str.cstr is an address, written for the file to
+ * be mapped at base. It is mapped there when that range is free and is
+ * used in place, pages coming from the page cache as they are first read.
+ * Otherwise a private copy of the mapping gets every str.cstr moved over.
+ * Snapshot strings are CSTR_PERMANENT as well, never released.
+ */
+#define CSTR_SNAP_MAGIC "CSTRSNP1"
+#if UINTPTR_MAX > 0xFFFFFFFF
+#define CSTR_SNAP_BASE 0x600000000000ULL
+#else
+#define CSTR_SNAP_BASE 0x60000000ULL
+#endif
 
-/* FIXME: use C11 atomics */
-#define CSTR_LOCK()                                             \
-    ({                                                          \
-        while (__sync_lock_test_and_set(&(__cstr_ctx.lock), 1)) \
-        {                                                       \
-        }                                                       \
-    })
-#define CSTR_UNLOCK() ({ __sync_lock_release(&(__cstr_ctx.lock)); })
+struct __cstr_snap_header
+{
+    char magic[8];
+    uint32_t hash_check, node_bytes;
+    uint32_t groups, reserved;
+    uint64_t count, base, index, nodes, size;
+};
+
+struct __cstr_snap_group
+{
+    uint8_t ctrl[CSTR_GROUP];
+    uint32_t slot[CSTR_GROUP];
+};
+
+struct __cstr_snap_node
+{
+    struct __cstr_data str;
+    uint32_t size;
+    char buffer[];
+};
+
+#define CSTR_SNAP_NODE_BYTES(sz)                                          \
+    ((sizeof(struct __cstr_snap_node) + (sz) + 1 + CSTR_NODE_ALIGN - 1) & \
+     ~(size_t)(CSTR_NODE_ALIGN - 1))
+
+struct __cstr_interning
+{
+    struct __cstr_shard shard[CSTR_SHARDS];
+    _Atomic(const struct __cstr_snap_header *) snapshot;
+#ifdef CSTR_RECLAIM
+    _Alignas(CSTR_CACHE_LINE) atomic_ulong epoch;
+    _Atomic(struct __cstr_thread *) threads;
+#endif
+};
+
+static struct __cstr_interning __cstr_ctx
+#ifdef CSTR_RECLAIM
+    = {.epoch = 1}
+#endif
+;
+
+static inline void cstr_lock(struct __cstr_shard *s)
+{
+    while (atomic_exchange_explicit(&s->lock, 1, memory_order_acquire))
+        while (atomic_load_explicit(&s->lock, memory_order_relaxed))
+            sched_yield();
+}
+
+static inline void cstr_unlock(struct __cstr_shard *s)
+{
+    atomic_store_explicit(&s->lock, 0, memory_order_release);
+}
+
+/* The top bits of a multiplicative hash, the table uses the low ones */
+static inline struct __cstr_shard *cstr_shard(uint32_t hash)
+{
+    return &__cstr_ctx.shard[(hash * 2654435761u) >> (32 - CSTR_SHARD_BITS)];
+}
 
 static void *xalloc(size_t n)
 {
@@ -50,72 +256,445 @@ static void *xalloc(size_t n)
     return m;
 }
 
-static inline void insert_node(struct __cstr_node **hash,
-                               int sz,
-                               struct __cstr_node *node)
+#ifdef CSTR_RECLAIM
+static __thread struct __cstr_thread *cstr_self;
+static pthread_key_t cstr_self_key;
+static pthread_once_t cstr_self_once = PTHREAD_ONCE_INIT;
+
+/* A thread's record goes back to the list when it exits */
+static void thread_release(void *p)
+{
+    struct __cstr_thread *self = p;
+    atomic_store_explicit(&self->epoch, 0, memory_order_release);
+    atomic_store_explicit(&self->in_use, 0, memory_order_release);
+}
+
+static void thread_key_init(void)
+{
+    pthread_key_create(&cstr_self_key, thread_release);
+}
+
+static struct __cstr_thread *thread_register(void)
+{
+    struct __cstr_thread *self;
+
+    pthread_once(&cstr_self_once, thread_key_init);
+    for (self = atomic_load(&__cstr_ctx.threads); self; self = self->next)
+    {
+        int unused = 0;
+        if (atomic_compare_exchange_strong(&self->in_use, &unused, 1))
+            break;
+    }
+    if (!self)
+    {
+        self = aligned_alloc(CSTR_CACHE_LINE, sizeof(*self));
+        if (!self)
+            exit(-1);
+        atomic_init(&self->epoch, 0);
+        atomic_init(&self->in_use, 1);
+        self->next = atomic_load(&__cstr_ctx.threads);
+        while (!atomic_compare_exchange_weak(&__cstr_ctx.threads, &self->next,
+                                             self))
+            ;
+    }
+    pthread_setspecific(cstr_self_key, self);
+    return cstr_self = self;
+}
+
+/* The announcement is sequentially consistent so that it is visible before
+ * the lookup reads any table. The global epoch may have moved on between
+ * reading it and announcing it, with a reclaimer that missed the
+ * announcement, so it is read again and the announcement retried until the
+ * two agree.
+ */
+static inline struct __cstr_thread *epoch_enter(void)
+{
+    struct __cstr_thread *self = cstr_self;
+    if (!self)
+        self = thread_register();
+    unsigned long e =
+        atomic_load_explicit(&__cstr_ctx.epoch, memory_order_relaxed);
+    for (;;)
+    {
+        atomic_store(&self->epoch, e);
+        unsigned long now = atomic_load(&__cstr_ctx.epoch);
+        if (now == e)
+            break;
+        e = now;
+    }
+    return self;
+}
+
+static inline void epoch_exit(struct __cstr_thread *self)
+{
+    atomic_store_explicit(&self->epoch, 0, memory_order_release);
+}
+
+/* The global epoch, one more if no lookup is still in an older one */
+static unsigned long epoch_advance(void)
+{
+    unsigned long e = atomic_load(&__cstr_ctx.epoch);
+    for (struct __cstr_thread *t = atomic_load(&__cstr_ctx.threads); t;
+         t = t->next)
+    {
+        unsigned long te = atomic_load(&t->epoch);
+        if (te && te != e)
+            return e;
+    }
+    atomic_compare_exchange_strong(&__cstr_ctx.epoch, &e, e + 1);
+    return atomic_load(&__cstr_ctx.epoch);
+}
+
+/* Free lists and limbo lists link nodes through str.cstr, which lookups do
+ * not read.
+ */
+#define NODE_NEXT(n) (*(struct __cstr_node **)&(n)->str.cstr)
+
+/* Recycle whatever was unlinked two epochs before e. Called with the shard
+ * locked.
+ */
+static void limbo_collect(struct __cstr_shard *s, unsigned long e)
+{
+    for (int i = 0; i < CSTR_LIMBO; ++i)
+    {
+        struct __cstr_limbo *l = &s->limbo[i];
+        if (l->epoch + 2 > e)
+            continue;
+        while (l->nodes)
+        {
+            struct __cstr_node *n = l->nodes;
+            size_t c = CSTR_NODE_BYTES(n->size) / CSTR_NODE_ALIGN;
+            l->nodes = NODE_NEXT(n);
+            NODE_NEXT(n) = s->pool.free[c];
+            s->pool.free[c] = n;
+        }
+        while (l->tables)
+        {
+            struct __cstr_table *t = l->tables;
+            l->tables = t->retired;
+            free(t->group);
+            free(t);
+        }
+    }
+}
+
+/* The limbo list for the current epoch. Called with the shard locked. */
+static struct __cstr_limbo *limbo(struct __cstr_shard *s)
+{
+    unsigned long e = atomic_load(&__cstr_ctx.epoch);
+    if (++s->retiring >= CSTR_RECLAIM_BATCH)
+    {
+        s->retiring = 0;
+        e = epoch_advance();
+    }
+    struct __cstr_limbo *l = &s->limbo[e % CSTR_LIMBO];
+    if (l->epoch != e)
+    {
+        /* older by a multiple of three, hence safe to recycle */
+        limbo_collect(s, e);
+        l->epoch = e;
+    }
+    return l;
+}
+#endif
+
+/* Called with the shard locked */
+static void retire_table(struct __cstr_shard *s, struct __cstr_table *t)
+{
+#ifdef CSTR_RECLAIM
+    struct __cstr_limbo *l = limbo(s);
+    t->retired = l->tables;
+    l->tables = t;
+#else
+    t->retired = s->retired;
+    s->retired = t;
+#endif
+}
+
+/* Group to start probing from in the high bits, tag in the top 7 */
+static inline uint64_t spread(uint32_t hash)
+{
+    return hash * 0x9E3779B97F4A7C15ULL;
+}
+
+#define SPREAD_TAG(h) ((uint8_t)((h) >> 57 | 0x80))
+#define SPREAD_GROUP(h) ((unsigned)((h) >> 25))
+
+/* Bit i set when control byte i of the group equals tag. A control byte
+ * may be stale when read along with an insert; that only hides the new
+ * node, as if the lookup came first. The vector load cannot be atomic, so
+ * ThreadSanitizer is told to let it be.
+ */
+__attribute__((no_sanitize("thread")))
+static inline unsigned match_group(const uint8_t *ctrl, uint8_t tag)
+{
+#ifdef __SSE2__
+    __m128i g = _mm_load_si128((const __m128i *)ctrl);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(tag)));
+#else
+    unsigned m = 0;
+    for (int i = 0; i < CSTR_GROUP; ++i)
+        m |= (unsigned)(ctrl[i] == tag) << i;
+    return m;
+#endif
+}
+
+static inline unsigned match_empty(const uint8_t *ctrl)
 {
-    uint32_t h = node->str.hash_size;
-    int index = h & (sz - 1);
-    node->next = hash[index];
-    hash[index] = node;
+    return match_group(ctrl, CSTR_EMPTY);
 }
 
-static void expand(struct __cstr_interning *si)
+/* Empty or deleted slots. Only used with the shard locked. */
+static inline unsigned match_free(const uint8_t *ctrl)
 {
-    unsigned new_size = si->size * 2;
-    if (new_size < HASH_START_SIZE)
-        new_size = HASH_START_SIZE;
+#ifdef __SSE2__
+    __m128i g = _mm_load_si128((const __m128i *)ctrl);
+    return ~_mm_movemask_epi8(g) & ((1u << CSTR_GROUP) - 1);
+#else
+    unsigned m = 0;
+    for (int i = 0; i < CSTR_GROUP; ++i)
+        m |= (unsigned)!CSTR_FULL(ctrl[i]) << i;
+    return m;
+#endif
+}
 
-    struct __cstr_node **new_hash =
-        xalloc(sizeof(struct __cstr_node *) * new_size);
-    memset(new_hash, 0, sizeof(struct __cstr_node *) * new_size);
+/* Large tables come zeroed straight from the kernel, page by page as they
+ * are first written, so creating one costs no pass over it.
+ */
+static struct __cstr_table *new_table(unsigned groups,
+                                      struct __cstr_table *old)
+{
+    struct __cstr_table *t = xalloc(sizeof(*t));
+    t->group = calloc(groups, sizeof(t->group[0]));
+    if (!t->group)
+        exit(-1);
+    t->groups = groups;
+    t->deleted = 0;
+    atomic_init(&t->old, old);
+    t->max_probe = 0;
+    atomic_init(&t->migrated, 0);
+    t->retired = NULL;
+    return t;
+}
 
-    for (unsigned i = 0; i < si->size; ++i)
+static inline size_t table_bytes(const struct __cstr_table *t)
+{
+    return sizeof(*t) + sizeof(t->group[0]) * t->groups;
+}
+
+/* Put node in the first free slot of its probe sequence. The slot is
+ * written before the control byte, a lookup seeing the tag finds it.
+ */
+static void insert_node(struct __cstr_table *t, struct __cstr_node *node)
+{
+    uint64_t h = spread(node->str.hash_size);
+    unsigned mask = t->groups - 1, g = SPREAD_GROUP(h) & mask;
+
+    for (unsigned step = 1;; g = (g + step++) & mask)
     {
-        struct __cstr_node *node = si->hash[i];
-        while (node)
+        struct __cstr_group *grp = &t->group[g];
+        unsigned free = match_free(grp->ctrl);
+        if (free)
         {
-            struct __cstr_node *tmp = node->next;
-            insert_node(new_hash, new_size, node);
-            node = tmp;
+            int i = __builtin_ctz(free);
+            if (grp->ctrl[i] == CSTR_DELETED)
+                --t->deleted;
+            atomic_store_explicit(&grp->slot[i], node, memory_order_release);
+            __atomic_store_n(&grp->ctrl[i], SPREAD_TAG(h), __ATOMIC_RELEASE);
+            if (step - 1 > t->max_probe)
+                t->max_probe = step - 1;
+            return;
         }
     }
+}
+
+/* Move up to n nodes of the old table into t. Called with the shard
+ * locked.
+ */
+static void migrate(struct __cstr_shard *s, struct __cstr_table *t, size_t n)
+{
+    struct __cstr_table *old =
+        atomic_load_explicit(&t->old, memory_order_relaxed);
+    if (!old)
+        return;
 
-    free(si->hash);
-    si->hash = new_hash;
-    si->size = new_size;
+    size_t slots = (size_t)old->groups * CSTR_GROUP,
+           migrated = atomic_load_explicit(&t->migrated, memory_order_relaxed);
+    for (; n && migrated < slots; ++migrated)
+    {
+        struct __cstr_group *grp = &old->group[migrated / CSTR_GROUP];
+        int i = migrated % CSTR_GROUP;
+        if (CSTR_FULL(grp->ctrl[i]))
+        {
+            insert_node(t, atomic_load_explicit(&grp->slot[i],
+                                                memory_order_relaxed));
+            --n;
+        }
+    }
+    atomic_store_explicit(&t->migrated, migrated, memory_order_release);
+    if (migrated == slots)
+    {
+        atomic_store_explicit(&t->old, NULL, memory_order_release);
+        retire_table(s, old);
+        return;
+    }
+
+    /* have the nodes the next call moves in cache by then */
+    for (size_t i = migrated, k = CSTR_MIGRATE_NODES; k && i < slots; ++i)
+    {
+        struct __cstr_group *grp = &old->group[i / CSTR_GROUP];
+        if (CSTR_FULL(grp->ctrl[i % CSTR_GROUP]))
+        {
+            __builtin_prefetch(atomic_load_explicit(
+                &grp->slot[i % CSTR_GROUP], memory_order_relaxed));
+            --k;
+        }
+    }
 }
 
-static cstring interning(struct __cstr_interning *si,
-                         const char *cstr,
-                         size_t sz,
-                         uint32_t hash)
+/* Called with the shard locked */
+static void expand(struct __cstr_shard *s)
 {
-    if (!si->hash)
-        return NULL;
+    struct __cstr_table *old =
+        atomic_load_explicit(&s->table, memory_order_relaxed);
+    unsigned groups = CSTR_MIN_GROUPS;
+    if (old)
+    {
+        migrate(s, old, SIZE_MAX); /* only if inserts outran migration */
+        /* the same size if it is mostly deleted slots */
+        groups = old->groups;
+        if (s->total * 16 >= old->groups * CSTR_GROUP * 7)
+            groups *= 2;
+    }
 
-    int index = (int)(hash & (si->size - 1));
-    struct __cstr_node *n = si->hash[index];
-    while (n)
+    struct __cstr_table *t = new_table(groups, old);
+    atomic_store_explicit(&s->table, t, memory_order_release);
+}
+
+static struct __cstr_node *probe(struct __cstr_table *t,
+                                 const char *cstr,
+                                 size_t sz,
+                                 uint32_t hash)
+{
+    uint64_t h = spread(hash);
+    unsigned mask = t->groups - 1, g = SPREAD_GROUP(h) & mask;
+    for (unsigned step = 1;; g = (g + step++) & mask)
     {
-        if (n->str.hash_size == hash)
+        struct __cstr_group *grp = &t->group[g];
+        for (unsigned m = match_group(grp->ctrl, SPREAD_TAG(h)); m; m &= m - 1)
         {
-            if (!strcmp(n->str.cstr, cstr))
-                return &n->str;
+            struct __cstr_node *n = atomic_load_explicit(
+                &grp->slot[__builtin_ctz(m)], memory_order_acquire);
+            /* the hash is cleared when the node is reclaimed */
+            if (n &&
+                __atomic_load_n(&n->str.hash_size, __ATOMIC_RELAXED) == hash &&
+                n->size == sz && !memcmp(n->buffer, cstr, sz))
+                return n;
         }
-        n = n->next;
+        if (match_empty(grp->ctrl))
+            return NULL;
     }
-    // 80% (4/5) threshold
-    if (si->total * 5 >= si->size * 4)
+}
+
+/* Whether every group of old that could hold hash has been moved. Groups
+ * are moved in order, and a node is at most max_probe steps from its first
+ * group.
+ */
+static inline int migrated_past(const struct __cstr_table *old,
+                                size_t migrated,
+                                uint32_t hash)
+{
+    size_t g = SPREAD_GROUP(spread(hash)) & (old->groups - 1),
+           k = old->max_probe;
+    return g + k * (k + 1) / 2 < migrated / CSTR_GROUP;
+}
+
+/* The new table first, then the part of the old one yet to be moved */
+static struct __cstr_node *lookup(struct __cstr_shard *s,
+                                  const char *cstr,
+                                  size_t sz,
+                                  uint32_t hash)
+{
+    struct __cstr_table *t =
+        atomic_load_explicit(&s->table, memory_order_acquire);
+    if (!t)
         return NULL;
-    if (!si->pool)
+
+    /* moved nodes are in t by the time migrated says so */
+    struct __cstr_table *old =
+        atomic_load_explicit(&t->old, memory_order_acquire);
+    size_t migrated =
+        old ? atomic_load_explicit(&t->migrated, memory_order_acquire) : 0;
+
+    struct __cstr_node *ret = probe(t, cstr, sz, hash);
+    if (!ret && old && !migrated_past(old, migrated, hash))
+        ret = probe(old, cstr, sz, hash);
+    return ret;
+}
+
+/* Called with the shard locked */
+static struct __cstr_node *alloc_node(struct __cstr_pool *p, size_t sz)
+{
+    size_t n = CSTR_NODE_BYTES(sz);
+    struct __cstr_node *node;
+
+    p->used += n;
+#ifdef CSTR_RECLAIM
+    if ((node = p->free[n / CSTR_NODE_ALIGN]))
+    {
+        p->free[n / CSTR_NODE_ALIGN] = NODE_NEXT(node);
+        return node;
+    }
+#endif
+    if ((size_t)(p->end - p->next) < n)
+    {
+        size_t size = p->chunk ? p->chunk->size * 2 : CSTR_CHUNK_MIN;
+        if (size > CSTR_CHUNK_MAX)
+            size = CSTR_CHUNK_MAX;
+        struct __cstr_chunk *c = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (c == MAP_FAILED)
+            exit(-1);
+#ifdef CSTR_HUGE_PAGES
+        if (size == CSTR_CHUNK_MAX)
+            madvise(c, size, MADV_HUGEPAGE);
+#endif
+        c->prev = p->chunk;
+        c->size = size;
+        p->chunk = c;
+        p->next = c->data;
+        p->end = (char *)c + size;
+        p->mapped += size;
+    }
+    node = (struct __cstr_node *)p->next;
+    p->next += n;
+    return node;
+}
+
+/* Called with the shard locked */
+static struct __cstr_node *interning(struct __cstr_shard *s,
+                                     const char *cstr,
+                                     size_t sz,
+                                     uint32_t hash)
+{
+    struct __cstr_table *t =
+        atomic_load_explicit(&s->table, memory_order_relaxed);
+    if (t)
+        migrate(s, t, CSTR_MIGRATE_NODES);
+    // 87.5% (7/8) threshold
+    if (!t || (s->total + t->deleted) * 8 >= t->groups * CSTR_GROUP * 7)
     {
-        si->pool = xalloc(sizeof(struct __cstr_pool));
-        si->index = 0;
+        expand(s);
+        t = atomic_load_explicit(&s->table, memory_order_relaxed);
     }
-    n = &si->pool->node[si->index++];
+
+    struct __cstr_node *n = alloc_node(&s->pool, sz);
     memcpy(n->buffer, cstr, sz);
     n->buffer[sz] = 0;
+    n->size = sz;
+#ifdef CSTR_RECLAIM
+    atomic_init(&n->ref, 1);
+#endif
 
     cstring cs = &n->str;
     cs->cstr = n->buffer;
@@ -123,36 +702,147 @@ static cstring interning(struct __cstr_interning *si,
     cs->type = CSTR_INTERNING;
     cs->ref = 0;
 
-    n->next = si->hash[index];
-    si->hash[index] = n;
+    insert_node(t, n);
+    ++s->total;
 
-    ++__cstr_ctx.total;
+    return n;
+}
 
-    return cs;
+#ifdef CSTR_RECLAIM
+/* A reference to n unless it is dying */
+static inline int node_get(struct __cstr_node *n)
+{
+    unsigned ref = atomic_load_explicit(&n->ref, memory_order_relaxed);
+    do
+    {
+        if (!ref)
+            return 0;
+    } while (!atomic_compare_exchange_weak_explicit(
+        &n->ref, &ref, ref + 1, memory_order_acquire, memory_order_relaxed));
+    return 1;
 }
 
-static cstring cstr_interning(const char *cstr, size_t sz, uint32_t hash)
+/* Turn the slot holding n into a deleted one */
+static int unlink_node(struct __cstr_table *t, struct __cstr_node *n)
 {
-    cstring ret;
-    CSTR_LOCK();
-    ret = interning(&__cstr_ctx, cstr, sz, hash);
-    if (!ret)
+    uint64_t h = spread(n->str.hash_size);
+    unsigned mask = t->groups - 1, g = SPREAD_GROUP(h) & mask;
+    for (unsigned step = 1;; g = (g + step++) & mask)
     {
-        expand(&__cstr_ctx);
-        ret = interning(&__cstr_ctx, cstr, sz, hash);
+        struct __cstr_group *grp = &t->group[g];
+        for (unsigned m = match_group(grp->ctrl, SPREAD_TAG(h)); m; m &= m - 1)
+        {
+            int i = __builtin_ctz(m);
+            if (atomic_load_explicit(&grp->slot[i], memory_order_relaxed) == n)
+            {
+                __atomic_store_n(&grp->ctrl[i], CSTR_DELETED, __ATOMIC_RELEASE);
+                atomic_store_explicit(&grp->slot[i], NULL,
+                                      memory_order_relaxed);
+                ++t->deleted;
+                return 1;
+            }
+        }
+        if (match_empty(grp->ctrl))
+            return 0;
     }
-    CSTR_UNLOCK();
-    return ret;
 }
 
-static inline uint32_t hash_blob(const char *buffer, size_t len)
+/* Drop a reference to an interned string, the last one reclaims it */
+static void release_node(struct __cstr_node *n)
 {
-    const uint8_t *ptr = (const uint8_t *)buffer;
-    size_t h = len;
-    size_t step = (len >> 5) + 1;
-    for (size_t i = len; i >= step; i -= step)
-        h = h ^ ((h << 5) + (h >> 2) + ptr[i - 1]);
-    return h == 0 ? 1 : h;
+    /* a node never leaves its shard, so this is right even if n is
+     * reclaimed and reused as soon as the reference is gone
+     */
+    struct __cstr_shard *s = cstr_shard(n->str.hash_size);
+    if (atomic_fetch_sub_explicit(&n->ref, 1, memory_order_release) != 1)
+        return;
+
+    cstr_lock(s);
+    /* not brought back or reclaimed by someone else meanwhile */
+    if (!atomic_load_explicit(&n->ref, memory_order_acquire) &&
+        n->str.hash_size)
+    {
+        struct __cstr_table *t =
+            atomic_load_explicit(&s->table, memory_order_relaxed);
+        struct __cstr_table *old =
+            atomic_load_explicit(&t->old, memory_order_relaxed);
+        if (!unlink_node(t, n) && old)
+            unlink_node(old, n);
+        --s->total;
+        s->pool.used -= CSTR_NODE_BYTES(n->size);
+        /* no lookup matches it any more, whichever table it is found in */
+        __atomic_store_n(&n->str.hash_size, 0, __ATOMIC_RELAXED);
+
+        struct __cstr_limbo *l = limbo(s);
+        NODE_NEXT(n) = l->nodes;
+        l->nodes = n;
+    }
+    cstr_unlock(s);
+}
+#endif
+
+/* Probing stops after every group was seen, should the file be full */
+static struct __cstr_snap_node *snap_probe(const struct __cstr_snap_header *h,
+                                           const char *cstr,
+                                           size_t sz,
+                                           uint32_t hash)
+{
+    const struct __cstr_snap_group *group =
+        (const void *)((const char *)h + h->index);
+    uint64_t sh = spread(hash);
+    unsigned mask = h->groups - 1, g = SPREAD_GROUP(sh) & mask;
+    for (unsigned step = 1; step <= h->groups; g = (g + step++) & mask)
+    {
+        const struct __cstr_snap_group *grp = &group[g];
+        for (unsigned m = match_group(grp->ctrl, SPREAD_TAG(sh)); m; m &= m - 1)
+        {
+            uint64_t off = (uint64_t)grp->slot[__builtin_ctz(m)] *
+                           CSTR_NODE_ALIGN;
+            struct __cstr_snap_node *n = (void *)((char *)h + off);
+            if (off + CSTR_SNAP_NODE_BYTES(sz) <= h->size &&
+                n->str.hash_size == hash && n->size == sz &&
+                !memcmp(n->buffer, cstr, sz))
+                return n;
+        }
+        if (match_empty(grp->ctrl))
+            return NULL;
+    }
+    return NULL;
+}
+
+static cstring cstr_interning(const char *cstr, size_t sz, uint32_t hash)
+{
+    struct __cstr_shard *s = cstr_shard(hash);
+    const struct __cstr_snap_header *snap =
+        atomic_load_explicit(&__cstr_ctx.snapshot, memory_order_acquire);
+    if (snap)
+    {
+        struct __cstr_snap_node *base = snap_probe(snap, cstr, sz, hash);
+        if (base)
+            return &base->str;
+    }
+#ifdef CSTR_RECLAIM
+    struct __cstr_thread *self = epoch_enter();
+    struct __cstr_node *n = lookup(s, cstr, sz, hash);
+    if (n && !node_get(n))
+        n = NULL;
+    epoch_exit(self);
+#else
+    struct __cstr_node *n = lookup(s, cstr, sz, hash);
+#endif
+    if (n)
+        return &n->str;
+
+    cstr_lock(s);
+    n = lookup(s, cstr, sz, hash);
+    if (!n)
+        n = interning(s, cstr, sz, hash);
+#ifdef CSTR_RECLAIM
+    else /* nothing is reclaimed while the lock is held */
+        atomic_fetch_add_explicit(&n->ref, 1, memory_order_relaxed);
+#endif
+    cstr_unlock(s);
+    return &n->str;
 }
 
 cstring cstr_clone(const char *cstr, size_t sz)
@@ -174,6 +864,14 @@ cstring cstr_clone(const char *cstr, size_t sz)
 
 cstring cstr_grab(cstring s)
 {
+#ifdef CSTR_RECLAIM
+    if (s->type == CSTR_INTERNING)
+    {
+        struct __cstr_node *n = (struct __cstr_node *)s;
+        atomic_fetch_add_explicit(&n->ref, 1, memory_order_relaxed);
+        return s;
+    }
+#endif
     if (s->type & (CSTR_PERMANENT | CSTR_INTERNING))
         return s;
     if (s->type == CSTR_ONSTACK)
@@ -187,6 +885,13 @@ cstring cstr_grab(cstring s)
 
 void cstr_release(cstring s)
 {
+#ifdef CSTR_RECLAIM
+    if (s->type == CSTR_INTERNING)
+    {
+        release_node((struct __cstr_node *)s);
+        return;
+    }
+#endif
     if (s->type || !s->ref)
         return;
     if (__sync_sub_and_fetch(&s->ref, 1) == 0)
@@ -206,7 +911,7 @@ int cstr_equal(cstring a, cstring b)
 {
     if (a == b)
         return 1;
-    if ((a->type == CSTR_INTERNING) && (b->type == CSTR_INTERNING))
+    if ((a->type & CSTR_INTERNING) && (b->type & CSTR_INTERNING))
         return 0;
     if ((a->type == CSTR_ONSTACK) && (b->type == CSTR_ONSTACK))
     {
@@ -270,18 +975,347 @@ cstring cstr_cat(cstr_buffer sb, const char *str)
     return sb->str;
 }
 
+/* The nodes in use, the index and the context. Pool chunks are mapped
+ * ahead of use but only their touched pages take memory, which is about
+ * the part in use.
+ */
 size_t strings_allocated_bytes()
 {
-    size_t s_pool = 0, s_table = 0, s_ctx = 0;
-    CSTR_LOCK();
-    if (__cstr_ctx.pool){
-        s_pool = sizeof(*__cstr_ctx.pool);
-        printf("pool: %ld bytes\n", s_pool);
+    size_t s_pool = 0, s_mapped = 0, s_table = 0, s_ctx = 0, s_snap = 0;
+    for (int i = 0; i < CSTR_SHARDS; ++i)
+    {
+        struct __cstr_shard *s = &__cstr_ctx.shard[i];
+        cstr_lock(s);
+        s_pool += s->pool.used;
+        s_mapped += s->pool.mapped;
+        struct __cstr_table *t = atomic_load(&s->table);
+        if (t)
+        {
+            s_table += table_bytes(t);
+            if (atomic_load(&t->old))
+                s_table += table_bytes(atomic_load(&t->old));
+        }
+        for (t = s->retired; t; t = t->retired)
+            s_table += table_bytes(t);
+#ifdef CSTR_RECLAIM
+        for (int k = 0; k < CSTR_LIMBO; ++k)
+            for (t = s->limbo[k].tables; t; t = t->retired)
+                s_table += table_bytes(t);
+#endif
+        cstr_unlock(s);
+    }
+    const struct __cstr_snap_header *snap = atomic_load(&__cstr_ctx.snapshot);
+    if (snap)
+    {
+        s_snap = snap->size;
+        printf("snapshot: %ld bytes mapped\n", s_snap);
     }
-    s_table = sizeof(struct __cstr_node *) * __cstr_ctx.size;
+    printf("pool: %ld bytes (%ld mapped)\n", s_pool, s_mapped);
     printf("hash table: %ld bytes\n", s_table);
     s_ctx = sizeof(__cstr_ctx);
     printf("ctx: %ld bytes\n", s_ctx);
-    CSTR_UNLOCK();
-    return s_pool + s_table + s_ctx;
-}
\ No newline at end of file
+    return s_snap + s_pool + s_table + s_ctx;
+}
+
+/* What a snapshot records of a string, read from a node or a snapshot */
+struct __cstr_snap_entry
+{
+    const char *buffer;
+    uint32_t hash, size;
+};
+
+static uint32_t snap_hash_check(void)
+{
+    return hash_blob(CSTR_SNAP_MAGIC, sizeof(CSTR_SNAP_MAGIC) - 1);
+}
+
+/* Called with every shard locked */
+static struct __cstr_snap_entry *snap_entries(size_t *count)
+{
+    const struct __cstr_snap_header *snap = atomic_load(&__cstr_ctx.snapshot);
+    size_t n = snap ? snap->count : 0;
+    for (int i = 0; i < CSTR_SHARDS; ++i)
+        n += __cstr_ctx.shard[i].total;
+
+    struct __cstr_snap_entry *e = xalloc((n + 1) * sizeof(*e));
+    *count = 0;
+    if (snap)
+    {
+        const struct __cstr_snap_group *group =
+            (const void *)((const char *)snap + snap->index);
+        for (size_t g = 0; g < snap->groups; ++g)
+            for (int i = 0; i < CSTR_GROUP; ++i)
+                if (CSTR_FULL(group[g].ctrl[i]))
+                {
+                    const struct __cstr_snap_node *node =
+                        (const void *)((const char *)snap +
+                                       (uint64_t)group[g].slot[i] *
+                                           CSTR_NODE_ALIGN);
+                    e[(*count)++] = (struct __cstr_snap_entry){
+                        node->buffer, node->str.hash_size, node->size};
+                }
+    }
+    for (int i = 0; i < CSTR_SHARDS; ++i)
+    {
+        struct __cstr_shard *s = &__cstr_ctx.shard[i];
+        struct __cstr_table *t =
+            atomic_load_explicit(&s->table, memory_order_relaxed);
+        if (!t)
+            continue;
+        /* all of the shard in one table */
+        migrate(s, t, SIZE_MAX);
+        for (size_t g = 0; g < t->groups; ++g)
+            for (int k = 0; k < CSTR_GROUP; ++k)
+                if (CSTR_FULL(t->group[g].ctrl[k]))
+                {
+                    struct __cstr_node *node = atomic_load_explicit(
+                        &t->group[g].slot[k], memory_order_relaxed);
+                    e[(*count)++] = (struct __cstr_snap_entry){
+                        node->buffer, node->str.hash_size, node->size};
+                }
+    }
+    return e;
+}
+
+/* Lay the snapshot of e out in m, which is zeroed, as the header says */
+static void snap_fill(char *m,
+                      const struct __cstr_snap_header *h,
+                      const struct __cstr_snap_entry *e)
+{
+    struct __cstr_snap_group *group = (void *)(m + h->index);
+    unsigned mask = h->groups - 1;
+    uint64_t off = h->nodes;
+
+    memcpy(m, h, sizeof(*h));
+    for (size_t i = 0; i < h->count; ++i)
+    {
+        uint64_t sh = spread(e[i].hash);
+        for (unsigned g = SPREAD_GROUP(sh) & mask, step = 1;;
+             g = (g + step++) & mask)
+        {
+            unsigned free = match_empty(group[g].ctrl);
+            if (free)
+            {
+                int k = __builtin_ctz(free);
+                group[g].ctrl[k] = SPREAD_TAG(sh);
+                group[g].slot[k] = off / CSTR_NODE_ALIGN;
+                break;
+            }
+        }
+
+        struct __cstr_snap_node *n = (void *)(m + off);
+        n->str.cstr = (char *)(uintptr_t)(
+            h->base + off + offsetof(struct __cstr_snap_node, buffer));
+        n->str.hash_size = e[i].hash;
+        n->str.type = CSTR_INTERNING | CSTR_PERMANENT;
+        n->size = e[i].size;
+        memcpy(n->buffer, e[i].buffer, e[i].size);
+        off += CSTR_SNAP_NODE_BYTES(e[i].size);
+    }
+}
+
+/* Make the last rename into the directory of path durable */
+static int snap_sync_dir(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    size_t len = slash ? (size_t)(slash - path) + (slash == path) : 1;
+    char *dir = xalloc(len + 1);
+    memcpy(dir, slash ? path : ".", len);
+    dir[len] = 0;
+
+    int ret = -1, fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (fd >= 0)
+    {
+        ret = fsync(fd);
+        close(fd);
+    }
+    free(dir);
+    return ret;
+}
+
+/* Write all interned strings, those of a loaded snapshot included, to a
+ * snapshot at path. The file is written aside under a unique name, synced
+ * and renamed over path, so a process that has the old one mapped keeps it
+ * intact and a crash leaves either of them whole. Returns 0, or -1 with
+ * errno set.
+ */
+int cstr_snapshot_save(const char *path)
+{
+    for (int i = 0; i < CSTR_SHARDS; ++i)
+        cstr_lock(&__cstr_ctx.shard[i]);
+
+    size_t count;
+    struct __cstr_snap_entry *e = snap_entries(&count);
+
+    /* as loaded as a live table right after it doubles */
+    struct __cstr_snap_header h = {
+        .magic = CSTR_SNAP_MAGIC,
+        .hash_check = snap_hash_check(),
+        .node_bytes = sizeof(struct __cstr_snap_node),
+        .groups = CSTR_MIN_GROUPS,
+        .count = count,
+        .base = CSTR_SNAP_BASE,
+        .index = CSTR_CACHE_LINE,
+    };
+    while (count * 16 >= (size_t)h.groups * CSTR_GROUP * 7)
+        h.groups *= 2;
+    h.nodes = h.index + sizeof(struct __cstr_snap_group) * h.groups;
+    h.size = h.nodes;
+    for (size_t i = 0; i < count; ++i)
+        h.size += CSTR_SNAP_NODE_BYTES(e[i].size);
+
+    /* written through a mapping of a file of its own next to path, which
+     * comes zeroed, and made durable before and after it takes its place
+     */
+    int ret = -1, fd = -1;
+    size_t len = strlen(path);
+    char *tmp = xalloc(len + sizeof(".XXXXXX"));
+    memcpy(tmp, path, len);
+    memcpy(tmp + len, ".XXXXXX", sizeof(".XXXXXX"));
+    if (h.size / CSTR_NODE_ALIGN > UINT32_MAX)
+        errno = EFBIG;
+    else if ((fd = mkstemp(tmp)) >= 0)
+    {
+        char *m = MAP_FAILED;
+        if (!fchmod(fd, 0644) && !ftruncate(fd, h.size))
+            m = mmap(NULL, h.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (m != MAP_FAILED)
+        {
+            snap_fill(m, &h, e);
+            munmap(m, h.size);
+        }
+        int synced = m != MAP_FAILED && !fsync(fd);
+        if (close(fd) || !synced || rename(tmp, path))
+            unlink(tmp);
+        else
+            ret = snap_sync_dir(path);
+    }
+
+    for (int i = 0; i < CSTR_SHARDS; ++i)
+        cstr_unlock(&__cstr_ctx.shard[i]);
+    free(tmp);
+    free(e);
+    return ret;
+}
+
+static int snap_valid(const struct __cstr_snap_header *h, off_t size)
+{
+    return !memcmp(h->magic, CSTR_SNAP_MAGIC, sizeof(h->magic)) &&
+           h->hash_check == snap_hash_check() &&
+           h->node_bytes == sizeof(struct __cstr_snap_node) &&
+           h->size == (uint64_t)size && h->size <= SIZE_MAX &&
+           h->groups && !(h->groups & (h->groups - 1)) &&
+           h->index >= sizeof(*h) && h->index % CSTR_CACHE_LINE == 0 &&
+           h->nodes == h->index + sizeof(struct __cstr_snap_group) * h->groups &&
+           h->nodes <= h->size && h->count < (uint64_t)h->groups * CSTR_GROUP;
+}
+
+/* The index of the mapped snapshot m, which the header only bounds: every
+ * full slot has to lead to a node within the file, holding a terminated
+ * string that is its own and matches the slot tag, and there have to be
+ * as many of them as the header counts.
+ */
+static int snap_check(const char *m, const struct __cstr_snap_header *h)
+{
+    const struct __cstr_snap_group *group = (const void *)(m + h->index);
+    uint64_t count = 0;
+    for (size_t g = 0; g < h->groups; ++g)
+        for (int i = 0; i < CSTR_GROUP; ++i)
+        {
+            if (!CSTR_FULL(group[g].ctrl[i]))
+                continue;
+            uint64_t off = (uint64_t)group[g].slot[i] * CSTR_NODE_ALIGN;
+            if (off < h->nodes || off > h->size ||
+                h->size - off < sizeof(struct __cstr_snap_node))
+                return 0;
+            const struct __cstr_snap_node *n = (const void *)(m + off);
+            if (n->size >= CSTR_INTERNING_SIZE ||
+                h->size - off < CSTR_SNAP_NODE_BYTES(n->size) ||
+                n->str.type != (CSTR_INTERNING | CSTR_PERMANENT) ||
+                n->str.cstr != n->buffer || n->buffer[n->size] ||
+                group[g].ctrl[i] != SPREAD_TAG(spread(n->str.hash_size)))
+                return 0;
+            ++count;
+        }
+    return count == h->count;
+}
+
+/* The file mapped anywhere, with its strings moved to where it is */
+static void *snap_relocate(int fd, const struct __cstr_snap_header *h)
+{
+    char *m = mmap(NULL, h->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (m == MAP_FAILED)
+        return m;
+
+    uintptr_t delta = (uintptr_t)m - h->base;
+    for (uint64_t off = h->nodes; off < h->size;)
+    {
+        struct __cstr_snap_node *n = (void *)(m + off);
+        if (h->size - off < sizeof(*n) || n->size >= CSTR_INTERNING_SIZE)
+        {
+            munmap(m, h->size);
+            errno = EINVAL;
+            return MAP_FAILED;
+        }
+        n->str.cstr += delta;
+        off += CSTR_SNAP_NODE_BYTES(n->size);
+    }
+    mprotect(m, h->size, PROT_READ);
+    return m;
+}
+
+/* Use the snapshot at path as the base layer. This has to come before any
+ * string is interned, or EBUSY is returned, and at most once. A file that
+ * does not hold a consistent snapshot is rejected with EINVAL. Returns 0,
+ * or -1 with errno set.
+ */
+int cstr_snapshot_load(const char *path)
+{
+    struct __cstr_snap_header h;
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) || pread(fd, &h, sizeof(h), 0) != sizeof(h) ||
+        !snap_valid(&h, st.st_size))
+    {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    void *m = mmap((void *)(uintptr_t)h.base, h.size, PROT_READ, MAP_PRIVATE,
+                   fd, 0);
+    if (m != MAP_FAILED && m != (void *)(uintptr_t)h.base)
+    {
+        munmap(m, h.size);
+        m = snap_relocate(fd, &h);
+    }
+    close(fd);
+    if (m == MAP_FAILED)
+        return -1;
+    if (!snap_check(m, &h))
+    {
+        munmap(m, h.size);
+        errno = EINVAL;
+        return -1;
+    }
+
+    int busy = atomic_load(&__cstr_ctx.snapshot) != NULL;
+    for (int i = 0; i < CSTR_SHARDS; ++i)
+    {
+        cstr_lock(&__cstr_ctx.shard[i]);
+        busy |= atomic_load(&__cstr_ctx.shard[i].table) != NULL;
+    }
+    if (!busy)
+        atomic_store_explicit(&__cstr_ctx.snapshot, m, memory_order_release);
+    for (int i = 0; i < CSTR_SHARDS; ++i)
+        cstr_unlock(&__cstr_ctx.shard[i]);
+    if (busy)
+    {
+        munmap(m, h.size);
+        errno = EBUSY;
+        return -1;
+    }
+    return 0;
+}
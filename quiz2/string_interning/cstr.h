@@ -45,10 +45,10 @@ typedef struct __cstr_buffer {
         }                                                                     \
     }
 
-#define CSTR_CLOSE(var)               \
-    do {                              \
-        if (!(var)->str->type)        \
-            cstr_release((var)->str); \
+#define CSTR_CLOSE(var)                       \
+    do {                                      \
+        if ((var)->str->type != CSTR_ONSTACK) \
+            cstr_release((var)->str);         \
     } while (0)
 
 /* Public API */
@@ -57,4 +57,8 @@ cstring cstr_clone(const char *cstr, size_t sz);
 cstring cstr_cat(cstr_buffer sb, const char *str);
 int cstr_equal(cstring a, cstring b);
 void cstr_release(cstring s);
-size_t strings_allocated_bytes();
\ No newline at end of file
+size_t strings_allocated_bytes();
+
+/* Interned strings saved to a file that another process maps back */
+int cstr_snapshot_save(const char *path);
+int cstr_snapshot_load(const char *path);
\ No newline at end of file
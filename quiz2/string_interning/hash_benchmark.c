@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "hash.h"
+#include "unsigned.h"
+
+/* Hash speed and table spread of the cstr hash against the sampling one it
+ * replaced, on numeric strings and on URLs.
+ */
+#define KEYS (1 << 20)
+#define KEY_SIZE 128
+#define ROUNDS 20
+#define MAX_CHAIN 8
+
+static const char *hosts[] = {"example.com", "api.example.com",
+                              "static.example-cdn.net", "www.example.org"};
+static const char *paths[] = {"users", "posts", "comments", "search",
+                              "assets/images", "v2/orders"};
+
+/* what cstr hashed with before: every (len / 32 + 1)-th byte */
+static inline uint32_t hash_sampled(const char *buffer, size_t len)
+{
+    const uint8_t *ptr = (const uint8_t *) buffer;
+    size_t h = len;
+    size_t step = (len >> 5) + 1;
+    for (size_t i = len; i >= step; i -= step)
+        h = h ^ ((h << 5) + (h >> 2) + ptr[i - 1]);
+    return h == 0 ? 1 : h;
+}
+
+typedef struct __keys {
+    const char *name;
+    char *buf;
+    size_t len[KEYS];
+} keys;
+
+static uint64_t rng_state = 88172645463325252ULL;
+
+static uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state >> 32;
+}
+
+static void make_numbers(keys *k)
+{
+    k->name = "numbers";
+    for (uint32_t i = 0; i < KEYS; ++i) {
+        char *p = k->buf + (size_t) i * KEY_SIZE;
+        unsigned_string(p, i);
+        k->len[i] = strlen(p);
+    }
+}
+
+static void make_urls(keys *k)
+{
+    k->name = "urls";
+    for (uint32_t i = 0; i < KEYS; ++i) {
+        char *p = k->buf + (size_t) i * KEY_SIZE;
+        k->len[i] = snprintf(p, KEY_SIZE, "https://%s/%s/%u?page=%u&sort=date",
+                             hosts[rng() % 4], paths[rng() % 6], i,
+                             rng() % 100);
+    }
+}
+
+static double ns_per_hash(keys *k, uint32_t (*hash)(const char *, size_t))
+{
+    struct timespec start, end;
+    uint32_t sum = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int r = 0; r < ROUNDS; ++r)
+        for (uint32_t i = 0; i < KEYS; ++i)
+            sum += hash(k->buf + (size_t) i * KEY_SIZE, k->len[i]);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (!sum)
+        printf("# zero checksum\n");
+    return ((end.tv_sec - start.tv_sec) * 1e9 +
+            (end.tv_nsec - start.tv_nsec)) /
+           ((double) ROUNDS * KEYS);
+}
+
+/* Chains in a table of one bucket per key, indexed by the low bits the way
+ * cstr did: ideally Poisson(1), 37% empty and the longest around 9.
+ */
+static void chains(keys *k, uint32_t (*hash)(const char *, size_t))
+{
+    uint32_t *count = calloc(KEYS, sizeof(uint32_t));
+    size_t hist[MAX_CHAIN + 1] = {0}, longest = 0;
+
+    for (uint32_t i = 0; i < KEYS; ++i)
+        ++count[hash(k->buf + (size_t) i * KEY_SIZE, k->len[i]) & (KEYS - 1)];
+    for (uint32_t i = 0; i < KEYS; ++i) {
+        ++hist[count[i] < MAX_CHAIN ? count[i] : MAX_CHAIN];
+        if (count[i] > longest)
+            longest = count[i];
+    }
+    for (int i = 0; i <= MAX_CHAIN; ++i)
+        printf(" %.3f", (double) hist[i] / KEYS);
+    printf(" %zu\n", longest);
+    free(count);
+}
+
+int main(int argc, char *argv[])
+{
+    keys *k = malloc(sizeof(keys));
+    k->buf = malloc((size_t) KEYS * KEY_SIZE);
+
+    printf("# keys hash ns/hash chains(0..%d+ as fraction of buckets) "
+           "longest\n",
+           MAX_CHAIN);
+    for (int set = 0; set < 2; ++set) {
+        if (set)
+            make_urls(k);
+        else
+            make_numbers(k);
+        printf("%s sampled %.2f", k->name, ns_per_hash(k, hash_sampled));
+        chains(k, hash_sampled);
+        printf("%s wyhash %.2f", k->name, ns_per_hash(k, hash_blob));
+        chains(k, hash_blob);
+    }
+
+    free(k->buf);
+    free(k);
+    return 0;
+}
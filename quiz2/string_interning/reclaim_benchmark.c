@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "cstr.h"
+#include "unsigned.h"
+
+/* Interned strings that come and go: every key is released again once
+ * WINDOW newer ones are interned. With reclaiming, memory stays at what
+ * the window needs however many keys go through.
+ */
+#define WINDOW 100000
+#define CHECKPOINTS 5
+
+/* threads churning the same keys, which die and come back all the time */
+#define MT_KEYS 50000
+#define MT_ROUNDS 2000000
+#define MT_MAX_THREADS 8
+
+static double seconds(struct timespec *start, struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) +
+           (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void *churn_shared(void *__input)
+{
+    uint32_t seed = (uintptr_t) __input;
+    cstring ring[64] = {0};
+    char buffer[12] = {0};
+    for (uint32_t i = 0; i < MT_ROUNDS; ++i) {
+        seed = seed * 1103515245 + 12345;
+        unsigned_string(buffer, (seed >> 8) % MT_KEYS);
+        cstring s = cstr_clone(buffer, strlen(buffer));
+        if (strcmp(s->cstr, buffer))
+            abort();
+        if (ring[i % 64])
+            cstr_release(ring[i % 64]);
+        ring[i % 64] = s;
+    }
+    for (int i = 0; i < 64; ++i)
+        if (ring[i])
+            cstr_release(ring[i]);
+    return NULL;
+}
+
+static void bench_threads(void)
+{
+    pthread_t threads[MT_MAX_THREADS];
+    struct timespec start, end;
+
+    printf("# threads churn(Mops/s)\n");
+    for (int n = 1; n <= MT_MAX_THREADS; n *= 2) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int t = 0; t < n; ++t)
+            pthread_create(&threads[t], NULL, churn_shared,
+                           (void *) (uintptr_t) (t + 1));
+        for (int t = 0; t < n; ++t)
+            pthread_join(threads[t], NULL);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        printf("%d %.2f\n", n,
+               (double) MT_ROUNDS * n / seconds(&start, &end) / 1e6);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 5000000;
+    cstring *ring = (cstring *) calloc(WINDOW, sizeof(cstring));
+    char buffer[12] = {0};
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t i = 0; i < count; ++i) {
+        unsigned_string(buffer, i);
+        if (ring[i % WINDOW])
+            cstr_release(ring[i % WINDOW]);
+        ring[i % WINDOW] = cstr_clone(buffer, strlen(buffer));
+        if ((i + 1) % (count / CHECKPOINTS) == 0) {
+            printf("after %u keys:\n", i + 1);
+            strings_allocated_bytes();
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("Churn: %.2f Mops/s\n", count / seconds(&start, &end) / 1e6);
+
+    /* the live window, looked up again and again */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t k = count - WINDOW + i % WINDOW;
+        unsigned_string(buffer, k);
+        cstring s = cstr_clone(buffer, strlen(buffer));
+        if (s != ring[k % WINDOW])
+            abort();
+        cstr_release(s);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("Lookup: %.2f Mops/s\n", count / seconds(&start, &end) / 1e6);
+
+    for (uint32_t i = 0; i < WINDOW; ++i)
+        cstr_release(ring[i]);
+    free(ring);
+
+    bench_threads();
+    return 0;
+}
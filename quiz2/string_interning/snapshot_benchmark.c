@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cstr.h"
+#include "unsigned.h"
+
+/* Warm-up from scratch against warm-up from a snapshot: this process
+ * interns the keys and saves them, then runs again as a new process that
+ * maps them back.
+ */
+
+static double seconds(struct timespec *start, struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) +
+           (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void intern_keys(uint32_t lo, uint32_t hi)
+{
+    char buffer[12] = {0};
+    for (uint32_t i = lo; i < hi; ++i) {
+        unsigned_string(buffer, i);
+        cstr_clone(buffer, strlen(buffer));
+    }
+}
+
+/* a process with no strings yet */
+static int load_snapshot(const char *path, uint32_t count)
+{
+    struct timespec start, end;
+    char buffer[12] = {0};
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (cstr_snapshot_load(path)) {
+        perror("cstr_snapshot_load");
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("Load: %.3f ms\n", seconds(&start, &end) * 1e3);
+
+    /* the first pass faults the pages in */
+    for (int pass = 0; pass < 2; ++pass) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (uint32_t i = 0; i < count; ++i) {
+            unsigned_string(buffer, i);
+            cstring s = cstr_clone(buffer, strlen(buffer));
+            if (!(s->type & CSTR_PERMANENT) || strcmp(s->cstr, buffer))
+                abort();
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        printf("Lookup pass %d: %.2f Mops/s\n", pass + 1,
+               count / seconds(&start, &end) / 1e6);
+    }
+
+    /* new strings go to the shards */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    intern_keys(count, count + count / 10);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("Insert over the snapshot: %.2f Mops/s\n",
+           count / 10 / seconds(&start, &end) / 1e6);
+    unsigned_string(buffer, count);
+    if (cstr_clone(buffer, strlen(buffer))->type != CSTR_INTERNING)
+        abort();
+    strings_allocated_bytes();
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 5000000;
+    const char *path = argc > 2 ? argv[2] : "cstr.snapshot";
+    struct timespec start, end;
+
+    if (argc > 3 && !strcmp(argv[3], "load"))
+        return load_snapshot(path, count);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    intern_keys(0, count);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("Intern %u keys: %.3f ms\n", count, seconds(&start, &end) * 1e3);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (cstr_snapshot_save(path)) {
+        perror("cstr_snapshot_save");
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("Save: %.3f ms\n", seconds(&start, &end) * 1e3);
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        char arg[12] = {0};
+        unsigned_string(arg, count);
+        execl("/proc/self/exe", argv[0], arg, path, "load", (char *) NULL);
+        _exit(1);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    unlink(path);
+    return !WIFEXITED(status) || WEXITSTATUS(status);
+}
@@ -0,0 +1,82 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+
+#include "xs_slab.h"
+
+#define CLOCK_ID CLOCK_MONOTONIC_RAW
+#define ONE_SEC 1e9
+
+#define MIN_LEN 32
+#define MAX_LEN 4096
+#define SLOTS 16384
+#define OPERATIONS 10000000
+
+static xs slot[SLOTS];
+
+/* Random create / grow / free churn over a fixed set of live strings */
+static void churn(const char *name, const xs_allocator *a)
+{
+    struct timespec start = {0, 0};
+    struct timespec end = {0, 0};
+    struct rusage usage;
+
+    xs_set_allocator(a);
+    for (int i = 0; i < SLOTS; ++i)
+        xs_newempty(&slot[i]);
+
+    clock_gettime(CLOCK_ID, &start);
+    for (int i = 0; i < OPERATIONS; ++i)
+    {
+        xs *s = &slot[rand() % SLOTS];
+        if (!xs_is_ptr(s))
+        {
+            /* only the allocation is of interest, skip filling it */
+            xs_grow(s, MIN_LEN + rand() % (MAX_LEN - MIN_LEN));
+        }
+        else if ((rand() & 1) && xs_capacity(s) < MAX_LEN)
+        {
+            xs_grow(s, xs_capacity(s) + 1);
+        }
+        else
+        {
+            xs_free(s);
+        }
+    }
+    clock_gettime(CLOCK_ID, &end);
+
+    for (int i = 0; i < SLOTS; ++i)
+        xs_free(&slot[i]);
+
+    getrusage(RUSAGE_SELF, &usage);
+    printf("%s %.1f %ld\n", name,
+           ((double)(end.tv_sec - start.tv_sec) * ONE_SEC +
+            (end.tv_nsec - start.tv_nsec)) /
+               OPERATIONS,
+           usage.ru_maxrss);
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    /* one process per allocator so the peak RSS is not shared */
+    printf("# allocator ns/op maxrss(kB)\n");
+    fflush(stdout);
+    if (fork() == 0)
+    {
+        srand(1);
+        churn("malloc", &xs_libc_allocator);
+        return 0;
+    }
+    wait(NULL);
+    if (fork() == 0)
+    {
+        srand(1);
+        churn("slab", &xs_slab_allocator);
+        return 0;
+    }
+    wait(NULL);
+    return 0;
+}
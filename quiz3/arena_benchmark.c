@@ -0,0 +1,77 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "xs.h"
+
+#define CLOCK_ID CLOCK_MONOTONIC_RAW
+#define ONE_SEC 1e9
+
+#define REQUESTS (1 << 18)
+#define TEMPORARIES 16
+#define MAX_LEN 512
+
+static char input[MAX_LEN + 1];
+static size_t lens[TEMPORARIES];
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) * ONE_SEC +
+           (end->tv_nsec - start->tv_nsec);
+}
+
+/* what a request handler does with its temporaries: build them, extend
+ * some of them and drop all of them
+ */
+static size_t handle(void)
+{
+    xs tmp[TEMPORARIES];
+    size_t sum = 0;
+
+    for (int i = 0; i < TEMPORARIES; ++i)
+    {
+        xs_new_len(&tmp[i], input, lens[i]);
+        if (i % 2)
+            xs_concat(&tmp[i], &tmp[i - 1], xs_tmp("\r\n"));
+        sum += xs_size(&tmp[i]);
+    }
+    for (int i = 0; i < TEMPORARIES; ++i)
+        xs_free(&tmp[i]);
+    return sum;
+}
+
+int main(int argc, char *argv[])
+{
+    struct timespec start = {0, 0};
+    struct timespec end = {0, 0};
+    size_t sum = 0;
+
+    /* medium and large strings, short ones never allocate */
+    srand(time(NULL));
+    memset(input, 'x', MAX_LEN);
+    for (int i = 0; i < TEMPORARIES; ++i)
+        lens[i] = 32 + rand() % (MAX_LEN / 2 - 32);
+
+    clock_gettime(CLOCK_ID, &start);
+    for (int r = 0; r < REQUESTS; ++r)
+        sum += handle();
+    clock_gettime(CLOCK_ID, &end);
+    double t_heap = elapsed(&start, &end);
+
+    clock_gettime(CLOCK_ID, &start);
+    for (int r = 0; r < REQUESTS; ++r)
+    {
+        xs_scope scope;
+        xs_scope_begin(&scope);
+        sum += handle();
+        xs_scope_end(&scope);
+    }
+    clock_gettime(CLOCK_ID, &end);
+    double t_arena = elapsed(&start, &end);
+
+    printf("# method ns/request (%d temporaries, checksum %zu)\n",
+           TEMPORARIES, sum);
+    printf("heap %.2f\n", t_heap / REQUESTS);
+    printf("xs_scope %.2f\n", t_arena / REQUESTS);
+    return 0;
+}
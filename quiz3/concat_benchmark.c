@@ -0,0 +1,73 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "xs.h"
+
+#define CLOCK_ID CLOCK_MONOTONIC_RAW
+#define ONE_SEC 1e9
+
+#define MAX_FRAGMENTS 10000
+#define MAX_FRAGMENT_LEN 32
+#define ROUND 20
+
+static xs frag[MAX_FRAGMENTS];
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) * ONE_SEC +
+           (end->tv_nsec - start->tv_nsec);
+}
+
+int main(int argc, char *argv[])
+{
+    struct timespec start = {0, 0};
+    struct timespec end = {0, 0};
+    char buf[MAX_FRAGMENT_LEN + 1];
+
+    srand(time(NULL));
+    for (int i = 0; i < MAX_FRAGMENTS; ++i)
+    {
+        int len = 1 + rand() % MAX_FRAGMENT_LEN;
+        for (int j = 0; j < len; ++j)
+            buf[j] = 'a' + rand() % 26;
+        buf[len] = 0;
+        xs_new(&frag[i], buf);
+    }
+
+    printf("# fragments xs_concat(us) xs_append_n(us)\n");
+    for (int n = 10; n <= MAX_FRAGMENTS; n *= 10)
+    {
+        double t_concat = 0, t_append = 0;
+        for (int r = 0; r < ROUND; ++r)
+        {
+            xs a = xs_literal_empty(), b = xs_literal_empty();
+
+            clock_gettime(CLOCK_ID, &start);
+            for (int i = 0; i < n; ++i)
+                xs_concat(&a, xs_tmp(""), &frag[i]);
+            clock_gettime(CLOCK_ID, &end);
+            t_concat += elapsed(&start, &end);
+
+            clock_gettime(CLOCK_ID, &start);
+            xs_append_n(&b, frag, n);
+            clock_gettime(CLOCK_ID, &end);
+            t_append += elapsed(&start, &end);
+
+            if (xs_size(&a) != xs_size(&b) ||
+                memcmp(xs_data(&a), xs_data(&b), xs_size(&a) + 1))
+            {
+                fprintf(stderr, "results differ for %d fragments\n", n);
+                return 1;
+            }
+            xs_free(&a);
+            xs_free(&b);
+        }
+        printf("%d %.2f %.2f\n", n, t_concat / ROUND / 1e3,
+               t_append / ROUND / 1e3);
+    }
+
+    for (int i = 0; i < MAX_FRAGMENTS; ++i)
+        xs_free(&frag[i]);
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "xs.h"
+
+#ifndef XS_ATOMIC_REFCNT
+#error "build with -DXS_ATOMIC_REFCNT, the plain refcount races"
+#endif
+
+#define CLOCK_ID CLOCK_MONOTONIC_RAW
+#define ONE_SEC 1e9
+
+#define PAYLOAD_LEN 4096
+#define ITERATIONS 1000000
+#define COW_ITERATIONS 100000
+
+static xs shared;
+static pthread_barrier_t barrier;
+
+/* Pass copies around without touching the payload */
+static void *copy_free(void *arg)
+{
+    pthread_barrier_wait(&barrier);
+    for (int i = 0; i < ITERATIONS; ++i)
+    {
+        xs c = *xs_copy(&shared);
+        xs_free(&c);
+    }
+    return NULL;
+}
+
+/* Every copy is written once, which detaches it from the shared buffer */
+static void *copy_write_free(void *arg)
+{
+    pthread_barrier_wait(&barrier);
+    for (int i = 0; i < COW_ITERATIONS; ++i)
+    {
+        xs c = *xs_copy(&shared);
+        xs_trim(&c, "\n");
+        xs_free(&c);
+    }
+    return NULL;
+}
+
+/* Returns the throughput in million operations per second */
+static double run(void *(*func)(void *), int nthreads, int iterations)
+{
+    pthread_t threads[nthreads];
+    struct timespec start = {0, 0};
+    struct timespec end = {0, 0};
+
+    pthread_barrier_init(&barrier, NULL, nthreads + 1);
+    for (int i = 0; i < nthreads; ++i)
+        pthread_create(&threads[i], NULL, func, NULL);
+
+    clock_gettime(CLOCK_ID, &start);
+    pthread_barrier_wait(&barrier);
+    for (int i = 0; i < nthreads; ++i)
+        pthread_join(threads[i], NULL);
+    clock_gettime(CLOCK_ID, &end);
+    pthread_barrier_destroy(&barrier);
+
+    double sec = (double)(end.tv_sec - start.tv_sec) +
+                 (end.tv_nsec - start.tv_nsec) / ONE_SEC;
+    return (double)nthreads * iterations / sec / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    static char payload[PAYLOAD_LEN + 1];
+    int max_threads = argc > 1 ? atoi(argv[1]) : sysconf(_SC_NPROCESSORS_ONLN);
+
+    memset(payload, 'x', PAYLOAD_LEN);
+    payload[PAYLOAD_LEN - 1] = '\n';
+    xs_new(&shared, payload);
+
+    printf("# threads copy_free(Mops/s) copy_write_free(Mops/s)\n");
+    for (int t = 1; t <= max_threads; ++t)
+    {
+        printf("%d %.2f %.2f\n", t, run(copy_free, t, ITERATIONS),
+               run(copy_write_free, t, COW_ITERATIONS));
+        if (xs_get_refcnt(&shared) != 1)
+        {
+            fprintf(stderr, "refcount leaked: %d\n", xs_get_refcnt(&shared));
+            return 1;
+        }
+    }
+
+    xs_free(&shared);
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "xs.h"
+
+#define CLOCK_ID CLOCK_MONOTONIC_RAW
+#define ONE_SEC 1e9
+
+#define MIN_SIZE (1 << 20)
+#define ROUND 5
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) * ONE_SEC +
+           (end->tv_nsec - start->tv_nsec);
+}
+
+/* What xs_from_file replaces: a heap buffer filled with read() */
+static xs *read_into_xs(xs *x, const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    size_t n = 0;
+
+    fstat(fd, &st);
+    xs_newempty(x);
+    xs_grow(x, st.st_size);
+    while (n < (size_t)st.st_size)
+    {
+        ssize_t r = read(fd, xs_data(x) + n, st.st_size - n);
+        if (r <= 0)
+            break;
+        n += r;
+    }
+    close(fd);
+    xs_data(x)[n] = 0;
+    x->size = n;
+    return x;
+}
+
+/* Touch every byte, so that page faults of the mapping are accounted */
+static size_t scan(const xs *x)
+{
+    const char *p = xs_data(x);
+    size_t sum = 0;
+    for (size_t i = 0; i < xs_size(x); i += 64)
+        sum += p[i];
+    return sum;
+}
+
+int main(int argc, char *argv[])
+{
+    struct timespec start = {0, 0};
+    struct timespec end = {0, 0};
+    size_t max_size = (argc > 1 ? atol(argv[1]) : 1024) << 20;
+    char path[] = "/tmp/xs_file_benchmark.XXXXXX";
+    static char block[1 << 20];
+    size_t sink = 0;
+
+    int fd = mkstemp(path);
+    if (fd < 0)
+        return 1;
+    memset(block, 'x', sizeof(block));
+
+    printf("# size(MiB) read(ms) read+scan(ms) mmap(ms) mmap+scan(ms)\n");
+    for (size_t size = MIN_SIZE, written = 0; size <= max_size; size <<= 1)
+    {
+        double t[4] = {0};
+        for (; written < size; written += sizeof(block))
+            if (write(fd, block, sizeof(block)) != sizeof(block))
+                return 1;
+
+        for (int r = 0; r < ROUND; ++r)
+        {
+            xs s;
+            for (int mapped = 0; mapped < 2; ++mapped)
+            {
+                clock_gettime(CLOCK_ID, &start);
+                if (mapped)
+                    xs_from_file(&s, path);
+                else
+                    read_into_xs(&s, path);
+                clock_gettime(CLOCK_ID, &end);
+                t[mapped * 2] += elapsed(&start, &end);
+
+                sink += scan(&s);
+                clock_gettime(CLOCK_ID, &end);
+                t[mapped * 2 + 1] += elapsed(&start, &end);
+                xs_free(&s);
+            }
+        }
+        printf("%zu %.2f %.2f %.2f %.2f\n", size >> 20, t[0] / ROUND / 1e6,
+               t[1] / ROUND / 1e6, t[2] / ROUND / 1e6, t[3] / ROUND / 1e6);
+    }
+
+    close(fd);
+    unlink(path);
+    return sink == 0;
+}
@@ -0,0 +1,101 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "xs.h"
+
+#define CLOCK_ID CLOCK_MONOTONIC_RAW
+#define ONE_SEC 1e9
+
+#define MIN_HAYSTACK (4 << 10)
+#define MAX_HAYSTACK (64 << 20)
+#define MAX_NEEDLE 256
+/* bytes scanned per measurement, whatever the haystack size */
+#define VOLUME (1UL << 30)
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) * ONE_SEC +
+           (end->tv_nsec - start->tv_nsec);
+}
+
+/* GB/s scanned to find the needle sitting at the very end of the haystack */
+static double run(const xs *h, const xs *needle, int level)
+{
+    struct timespec start = {0, 0};
+    struct timespec end = {0, 0};
+    size_t round = VOLUME / xs_size(h) + 1, expected = xs_size(h) - xs_size(needle);
+
+    clock_gettime(CLOCK_ID, &start);
+    for (size_t r = 0; r < round; ++r)
+    {
+        size_t pos;
+        if (level < 0)
+            pos = strstr(xs_data(h), xs_data(needle)) - xs_data(h);
+        else
+        {
+            xs_simd = level;
+            pos = xs_find(h, needle, 0);
+        }
+        if (pos != expected)
+        {
+            fprintf(stderr, "wrong match at %zu\n", pos);
+            exit(1);
+        }
+    }
+    clock_gettime(CLOCK_ID, &end);
+    return (double)round * xs_size(h) / elapsed(&start, &end);
+}
+
+int main(int argc, char *argv[])
+{
+    static char haystack[MAX_HAYSTACK + 1], needle[MAX_NEEDLE + 1];
+    int max_level = xs_simd_level();
+
+    /* no NUL bytes so that strstr can take part */
+    srand(time(NULL));
+    for (size_t i = 0; i < MAX_HAYSTACK; ++i)
+        haystack[i] = 1 + rand() % 255;
+
+    printf("# haystack needle strstr memmem sse2 avx2 (GB/s)\n");
+    for (size_t n = MIN_HAYSTACK; n <= MAX_HAYSTACK; n <<= 4)
+    {
+        for (size_t k = 1; k <= MAX_NEEDLE; k <<= 1)
+        {
+            xs h, nx;
+            char saved = haystack[n];
+
+            /* a needle not seen before the end of the haystack */
+            for (size_t i = 0; i < k; ++i)
+                needle[i] = haystack[n - k + i];
+            needle[k] = 0;
+            haystack[n] = 0;
+            xs_new_len(&h, haystack, n);
+            xs_new_len(&nx, needle, k);
+            if (xs_find(&h, &nx, 0) != n - k)
+            {
+                xs_free(&h);
+                xs_free(&nx);
+                haystack[n] = saved;
+                continue;
+            }
+
+            printf("%zu %zu %.2f", n, k, run(&h, &nx, -1));
+            for (int level = XS_SIMD_NONE; level <= XS_SIMD_AVX2; ++level)
+            {
+                if (level > max_level)
+                    printf(" -");
+                else
+                    printf(" %.2f", run(&h, &nx, level));
+            }
+            printf("\n");
+            xs_simd = max_level;
+
+            xs_free(&h);
+            xs_free(&nx);
+            haystack[n] = saved;
+        }
+        printf("\n");
+    }
+    return 0;
+}
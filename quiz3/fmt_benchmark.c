@@ -0,0 +1,100 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "xs_fmt.h"
+
+#define CLOCK_ID CLOCK_MONOTONIC_RAW
+#define ONE_SEC 1e9
+
+#define LINES (1 << 20)
+/* lines per log before it is freed and started over */
+#define LOG_LINES 64
+
+static const char *levels[] = {"DEBUG", "INFO", "WARN", "ERROR"};
+static const char *paths[] = {"/", "/index.html", "/api/v1/users",
+                              "/static/css/main.3f2a1c.css"};
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) * ONE_SEC +
+           (end->tv_nsec - start->tv_nsec);
+}
+
+/* the old way: snprintf into a stack buffer, then concatenate */
+static void log_snprintf(xs *log, int i)
+{
+    char buf[256];
+    xs line;
+    snprintf(buf, sizeof(buf), "%lld %s req=%d path=%s status=%u bytes=%zu\n",
+             1600000000000LL + i, levels[i & 3], i, paths[i >> 2 & 3],
+             200 + (i & 7), (size_t)i * 37);
+    xs_new_len(&line, buf, strlen(buf));
+    xs_concat(log, xs_tmp(""), &line);
+    xs_free(&line);
+}
+
+static void log_appendf(xs *log, int i)
+{
+    xs_appendf(log, "%lld %s req=%d path=%s status=%u bytes=%zu\n",
+               1600000000000LL + i, levels[i & 3], i, paths[i >> 2 & 3],
+               200 + (i & 7), (size_t)i * 37);
+}
+
+/* integers only: one number per append */
+static void ints_snprintf(xs *log, int i)
+{
+    char buf[32];
+    xs num;
+    snprintf(buf, sizeof(buf), "%lld", (long long)i * 1000003);
+    xs_new_len(&num, buf, strlen(buf));
+    xs_concat(log, xs_tmp(""), &num);
+    xs_free(&num);
+}
+
+static void ints_append(xs *log, int i)
+{
+    xs_append_i64(log, (long long)i * 1000003);
+}
+
+static double run(void (*f)(xs *, int), size_t *sum)
+{
+    struct timespec start = {0, 0};
+    struct timespec end = {0, 0};
+    xs log = *xs_tmp("");
+
+    clock_gettime(CLOCK_ID, &start);
+    for (int i = 0; i < LINES; ++i)
+    {
+        f(&log, i);
+        if (i % LOG_LINES == LOG_LINES - 1)
+        {
+            *sum += xs_size(&log);
+            xs_free(&log);
+            log = *xs_tmp("");
+        }
+    }
+    clock_gettime(CLOCK_ID, &end);
+    xs_free(&log);
+    return elapsed(&start, &end) / LINES;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t sum = 0, check = 0;
+
+    double t_log = run(log_snprintf, &sum);
+    double t_logf = run(log_appendf, &check);
+    if (sum != check)
+        printf("# log size mismatch %zu %zu\n", sum, check);
+    double t_int = run(ints_snprintf, &sum);
+    double t_inta = run(ints_append, &check);
+    if (sum != check)
+        printf("# int size mismatch %zu %zu\n", sum, check);
+
+    printf("# workload snprintf+xs_concat(ns) xs_appendf(ns) (checksum %zu)\n",
+           sum);
+    printf("log %.2f %.2f\n", t_log, t_logf);
+    printf("int %.2f %.2f\n", t_int, t_inta);
+    return 0;
+}
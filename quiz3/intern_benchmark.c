@@ -0,0 +1,126 @@
+#include <malloc.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "xs_intern.h"
+
+#define CLOCK_ID CLOCK_MONOTONIC_RAW
+#define ONE_SEC 1e9
+
+#define ITEMS (1 << 20)
+#define DISTINCT (1 << 14)
+#define MIN_LEN 32
+#define MAX_LEN 320
+
+static char *corpus[DISTINCT];
+static uint32_t picks[ITEMS];
+static xs items[ITEMS];
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) * ONE_SEC +
+           (end->tv_nsec - start->tv_nsec);
+}
+
+static size_t heap_in_use(void) { return mallinfo2().uordblks; }
+
+typedef struct
+{
+    size_t lo, hi;
+    bool intern;
+} job_t;
+
+static void *build(void *arg)
+{
+    job_t *job = (job_t *)arg;
+    for (size_t i = job->lo; i < job->hi; ++i)
+    {
+        xs_new(&items[i], corpus[picks[i]]);
+        if (job->intern)
+            xs_intern(&items[i]);
+    }
+    return NULL;
+}
+
+/* build all items with the given number of threads, in ns */
+static double run(int threads, bool intern)
+{
+    struct timespec start = {0, 0};
+    struct timespec end = {0, 0};
+    pthread_t tid[threads];
+    job_t jobs[threads];
+
+    clock_gettime(CLOCK_ID, &start);
+    for (int t = 0; t < threads; ++t)
+    {
+        jobs[t] = (job_t){ITEMS * t / threads, ITEMS * (t + 1) / threads,
+                          intern};
+        pthread_create(&tid[t], NULL, build, &jobs[t]);
+    }
+    for (int t = 0; t < threads; ++t)
+        pthread_join(tid[t], NULL);
+    clock_gettime(CLOCK_ID, &end);
+    return elapsed(&start, &end);
+}
+
+static double compare_all(void)
+{
+    struct timespec start = {0, 0};
+    struct timespec end = {0, 0};
+    size_t equal = 0;
+
+    clock_gettime(CLOCK_ID, &start);
+    for (size_t i = 1; i < ITEMS; ++i)
+        equal += xs_equal(&items[i], &items[i - 1]);
+    clock_gettime(CLOCK_ID, &end);
+    if (!equal)
+        puts("# no equal neighbours");
+    return elapsed(&start, &end);
+}
+
+int main(int argc, char *argv[])
+{
+    int threads = argc > 1 ? atoi(argv[1]) : sysconf(_SC_NPROCESSORS_ONLN);
+    char buf[MAX_LEN + 1];
+
+    /* a few values make up most of the corpus */
+    srand(time(NULL));
+    for (size_t i = 0; i < DISTINCT; ++i)
+    {
+        size_t len = MIN_LEN + rand() % (MAX_LEN - MIN_LEN + 1);
+        for (size_t j = 0; j < len; ++j)
+            buf[j] = 'a' + rand() % 26;
+        buf[len] = 0;
+        corpus[i] = strdup(buf);
+    }
+    for (size_t i = 0; i < ITEMS; ++i)
+    {
+        uint64_t r = rand() % DISTINCT;
+        picks[i] = r * r / DISTINCT;
+    }
+
+    /* the set keeps what the first interning run added, so the heap
+     * growth of the later runs is the strings alone
+     */
+    printf("# method threads build(ns/string) heap(MiB) equal(ns/pair)\n");
+    for (int intern = 0; intern <= 1; ++intern)
+    {
+        for (int t = 1; t <= threads; t = t == threads ? t + 1 : threads)
+        {
+            size_t before = heap_in_use();
+            double t_build = run(t, intern);
+            size_t heap = heap_in_use() - before;
+            double t_equal = compare_all();
+
+            printf("%s %d %.1f %.1f %.2f\n", intern ? "xs_intern" : "xs_new",
+                   t, t_build / ITEMS, (double)heap / (1 << 20),
+                   t_equal / (ITEMS - 1));
+            for (size_t i = 0; i < ITEMS; ++i)
+                xs_free(&items[i]);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "xs.h"
+
+#define CLOCK_ID CLOCK_MONOTONIC_RAW
+#define ONE_SEC 1e9
+
+#define REQUESTS (1 << 20)
+
+/* header and field names a response is built from, half of them too long
+ * for the short string
+ */
+#define HEADERS(_)                              \
+    _("Content-Type")                           \
+    _("Content-Length")                         \
+    _("Cache-Control")                          \
+    _("Date")                                   \
+    _("Server")                                 \
+    _("Vary")                                   \
+    _("Access-Control-Allow-Origin")            \
+    _("Access-Control-Allow-Credentials")       \
+    _("Access-Control-Expose-Headers-Extended") \
+    _("Strict-Transport-Security-Preload-List") \
+    _("Content-Security-Policy-Report-Only")    \
+    _("Cross-Origin-Embedder-Policy-Report-Only")
+
+#define STR(s) s,
+#define COUNT(s) +1
+#define NHEADERS (0 HEADERS(COUNT))
+
+static const char *names[] = {HEADERS(STR)};
+static xs fields[NHEADERS];
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) * ONE_SEC +
+           (end->tv_nsec - start->tv_nsec);
+}
+
+int main(int argc, char *argv[])
+{
+    struct timespec start = {0, 0};
+    struct timespec end = {0, 0};
+    size_t sum = 0;
+
+    clock_gettime(CLOCK_ID, &start);
+    for (int r = 0; r < REQUESTS; ++r)
+    {
+        for (int i = 0; i < NHEADERS; ++i)
+            xs_new(&fields[i], names[i]);
+        for (int i = 0; i < NHEADERS; ++i)
+        {
+            sum += xs_size(&fields[i]);
+            xs_free(&fields[i]);
+        }
+    }
+    clock_gettime(CLOCK_ID, &end);
+    double t_new = elapsed(&start, &end);
+
+    clock_gettime(CLOCK_ID, &start);
+    for (int r = 0; r < REQUESTS; ++r)
+    {
+        int i = 0;
+#define LITERAL(s) xs_new_literal(&fields[i++], s);
+        HEADERS(LITERAL)
+#undef LITERAL
+        for (i = 0; i < NHEADERS; ++i)
+        {
+            sum += xs_size(&fields[i]);
+            xs_free(&fields[i]);
+        }
+    }
+    clock_gettime(CLOCK_ID, &end);
+    double t_literal = elapsed(&start, &end);
+
+    printf("# method ns/request (%d names, checksum %zu)\n", NHEADERS, sum);
+    printf("xs_new %.2f\n", t_new / REQUESTS);
+    printf("xs_new_literal %.2f\n", t_literal / REQUESTS);
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "map_keys.h"
+#include "xs_map.h"
+
+#define CLOCK_ID CLOCK_MONOTONIC_RAW
+#define ONE_SEC 1e9
+
+static xs keys[MAP_KEYS], queries[MAP_KEYS];
+
+int main(int argc, char *argv[])
+{
+    struct timespec start = {0, 0};
+    struct timespec end = {0, 0};
+    char buf[MAP_MAX_KEY_LEN + 1];
+
+    printf("# keys lookup(ns) xs_map\n");
+    for (size_t d = 0; d < sizeof(key_dists) / sizeof(key_dists[0]); ++d)
+    {
+        xs_map m;
+        uint64_t state = 42, found = 0;
+
+        xs_map_init(&m);
+        for (size_t i = 0; i < MAP_KEYS; ++i)
+        {
+            gen_key(buf, i, key_dists[d].min_len, key_dists[d].max_len);
+            xs_new(&keys[i], buf);
+            *xs_map_put(&m, &keys[i]) = (void *)(i + 1);
+            /* what a request handler would look up with */
+            xs_copy_to(&queries[i], &keys[i]);
+        }
+
+        clock_gettime(CLOCK_ID, &start);
+        for (size_t i = 0; i < MAP_LOOKUPS; ++i)
+        {
+            void **v = xs_map_get(&m, &queries[key_rand(&state) % MAP_KEYS]);
+            found += v != NULL;
+        }
+        clock_gettime(CLOCK_ID, &end);
+
+        printf("%s %.1f\n", key_dists[d].name,
+               ((double)(end.tv_sec - start.tv_sec) * ONE_SEC +
+                (end.tv_nsec - start.tv_nsec)) /
+                   MAP_LOOKUPS);
+        if (found != MAP_LOOKUPS)
+            return 1;
+
+        xs_map_free(&m);
+        for (size_t i = 0; i < MAP_KEYS; ++i)
+        {
+            xs_free(&keys[i]);
+            xs_free(&queries[i]);
+        }
+    }
+    return 0;
+}
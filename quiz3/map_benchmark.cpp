@@ -0,0 +1,51 @@
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "map_keys.h"
+
+#define CLOCK_ID CLOCK_MONOTONIC_RAW
+#define ONE_SEC 1e9
+
+int main(int argc, char *argv[])
+{
+    struct timespec start = {0, 0};
+    struct timespec end = {0, 0};
+    char buf[MAP_MAX_KEY_LEN + 1];
+
+    std::cout << "# keys lookup(ns) std::unordered_map<std::string>"
+              << std::endl;
+    for (auto &dist : key_dists)
+    {
+        std::unordered_map<std::string, void *> m;
+        std::vector<std::string> queries;
+        uint64_t state = 42, found = 0;
+
+        queries.reserve(MAP_KEYS);
+        for (size_t i = 0; i < MAP_KEYS; ++i)
+        {
+            size_t len = gen_key(buf, i, dist.min_len, dist.max_len);
+            m.emplace(std::string(buf, len), (void *)(i + 1));
+            queries.emplace_back(buf, len);
+        }
+
+        clock_gettime(CLOCK_ID, &start);
+        for (size_t i = 0; i < MAP_LOOKUPS; ++i)
+        {
+            auto it = m.find(queries[key_rand(&state) % MAP_KEYS]);
+            found += it != m.end();
+        }
+        clock_gettime(CLOCK_ID, &end);
+
+        std::cout << dist.name << " "
+                  << ((double)(end.tv_sec - start.tv_sec) * ONE_SEC +
+                      (end.tv_nsec - start.tv_nsec)) /
+                         MAP_LOOKUPS
+                  << std::endl;
+        if (found != MAP_LOOKUPS)
+            return 1;
+    }
+    return 0;
+}
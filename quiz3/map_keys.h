@@ -0,0 +1,48 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/* Key workload shared by map_benchmark.c and map_benchmark.cpp */
+#define MAP_KEYS 1000000
+#define MAP_LOOKUPS 10000000
+#define MAP_MAX_KEY_LEN 512
+
+static const struct
+{
+    const char *name;
+    size_t min_len, max_len;
+} key_dists[] = {
+    {"short", 8, 24},
+    {"medium", 32, 96},
+    {"large", 256, 512},
+};
+
+static inline uint64_t key_rand(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+/* The i-th key of a distribution, NUL-terminated, returns its length */
+static inline size_t gen_key(char *buf, uint64_t i, size_t min_len,
+                             size_t max_len)
+{
+    uint64_t state = i * 0x9E3779B97F4A7C15ull + 1;
+    size_t len = min_len + key_rand(&state) % (max_len - min_len + 1);
+    /* a unique prefix, min_len leaves room for it, then filler */
+    size_t n = 0;
+    uint64_t v = i;
+    do
+    {
+        buf[n++] = 'a' + v % 26;
+        v /= 26;
+    } while (v);
+    buf[n++] = '/';
+    for (; n < len; n++)
+        buf[n] = 'a' + key_rand(&state) % 26;
+    buf[len] = 0;
+    return len;
+}
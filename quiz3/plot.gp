@@ -1,8 +1,20 @@
-set ylabel 'time (us)'
-set terminal png font " Times_New_Roman,12 "
-set output "output.png"
+# suite.txt: impl op dist threads ns/op ci95 cache-misses/op
+set xlabel 'threads'
+set ylabel 'time (ns/op)'
+set terminal png font " Times_New_Roman,12 " size 1280,960
 set grid
-set boxwidth 0.5
-set style fill solid
-set yrange [0:]
-plot "data.txt" using 1:($3/1000):xtic(2) with boxes title ""
\ No newline at end of file
+set key left top
+set logscale y
+set xtics 1
+
+ops = "construct copy cow_write concat trim grow free"
+dists = "short medium large"
+series(impl, op, dist) = sprintf("< awk '$1==\"%s\" && $2==\"%s\" && $3==\"%s\"' suite.txt", impl, op, dist)
+
+do for [op in ops] {
+    set output sprintf("%s.png", op)
+    set title op
+    plot for [dist in dists] series("xs", op, dist) using 4:5:6 with yerrorlines title sprintf("xs %s", dist), \
+         for [dist in dists] series("xs_string", op, dist) using 4:5:6 with yerrorlines dashtype 3 title sprintf("xs_string %s", dist), \
+         for [dist in dists] series("string", op, dist) using 4:5:6 with yerrorlines dashtype 2 title sprintf("string %s", dist)
+}
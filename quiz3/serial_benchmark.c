@@ -0,0 +1,101 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "xs_serial.h"
+
+#define CLOCK_ID CLOCK_MONOTONIC_RAW
+#define ONE_SEC 1e9
+
+#define ITEMS (1 << 20)
+#define MAX_LEN 128
+#define ROUND 5
+
+static xs items[ITEMS];
+static char line[MAX_LEN + 2];
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) * ONE_SEC +
+           (end->tv_nsec - start->tv_nsec);
+}
+
+int main(int argc, char *argv[])
+{
+    struct timespec start = {0, 0};
+    struct timespec end = {0, 0};
+    const char *path = argc > 1 ? argv[1] : "serial_benchmark.tmp";
+    double t[4] = {0};
+    size_t bytes = 0;
+
+    /* short and medium strings, newline-free for the text format */
+    srand(time(NULL));
+    for (size_t i = 0; i < ITEMS; ++i)
+    {
+        size_t len = 1 + rand() % MAX_LEN;
+        for (size_t j = 0; j < len; ++j)
+            line[j] = 'a' + rand() % 26;
+        xs_new_len(&items[i], line, len);
+        bytes += len;
+    }
+
+    for (int r = 0; r < ROUND; ++r)
+    {
+        /* one line per string */
+        FILE *f = fopen(path, "w");
+        clock_gettime(CLOCK_ID, &start);
+        for (size_t i = 0; i < ITEMS; ++i)
+            fprintf(f, "%s\n", xs_data(&items[i]));
+        fclose(f);
+        clock_gettime(CLOCK_ID, &end);
+        t[0] += elapsed(&start, &end);
+
+        static xs back[ITEMS];
+        f = fopen(path, "r");
+        clock_gettime(CLOCK_ID, &start);
+        for (size_t i = 0; fgets(line, sizeof(line), f); ++i)
+        {
+            line[strlen(line) - 1] = 0;
+            xs_new(&back[i], line);
+        }
+        fclose(f);
+        clock_gettime(CLOCK_ID, &end);
+        t[1] += elapsed(&start, &end);
+        for (size_t i = 0; i < ITEMS; ++i)
+            xs_free(&back[i]);
+
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        clock_gettime(CLOCK_ID, &start);
+        bool ok = xs_write_array(fd, items, ITEMS);
+        close(fd);
+        clock_gettime(CLOCK_ID, &end);
+        t[2] += elapsed(&start, &end);
+
+        size_t n = 0;
+        fd = open(path, O_RDONLY);
+        clock_gettime(CLOCK_ID, &start);
+        xs *v = xs_read_array(fd, &n);
+        close(fd);
+        clock_gettime(CLOCK_ID, &end);
+        t[3] += elapsed(&start, &end);
+
+        if (!ok || !v || n != ITEMS)
+            return 1;
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (!xs_equal(&v[i], &items[i]))
+                return 1;
+            xs_free(&v[i]);
+        }
+        free(v);
+    }
+    unlink(path);
+
+    printf("# method write(MB/s) read(MB/s) (%d strings, %zu MB)\n", ITEMS,
+           bytes >> 20);
+    printf("fprintf/fgets %.1f %.1f\n", bytes * ROUND / t[0] * 1e3,
+           bytes * ROUND / t[1] * 1e3);
+    printf("xs_write_array/xs_read_array %.1f %.1f\n",
+           bytes * ROUND / t[2] * 1e3, bytes * ROUND / t[3] * 1e3);
+    return 0;
+}
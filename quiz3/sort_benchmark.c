@@ -0,0 +1,101 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "xs_array.h"
+
+#define CLOCK_ID CLOCK_MONOTONIC_RAW
+#define ONE_SEC 1e9
+
+#define ITEMS (1 << 20)
+#define MIN_LEN 4
+#define MAX_LEN 64
+#define ROUND 5
+
+static xs input[ITEMS], sorted[ITEMS];
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) * ONE_SEC +
+           (end->tv_nsec - start->tv_nsec);
+}
+
+static int cmp_xs(const void *a, const void *b)
+{
+    return strcmp(xs_data((const xs *)a), xs_data((const xs *)b));
+}
+
+int main(int argc, char *argv[])
+{
+    struct timespec start = {0, 0};
+    struct timespec end = {0, 0};
+    int threads = argc > 1 ? atoi(argv[1]) : sysconf(_SC_NPROCESSORS_ONLN);
+    double t_qsort = 0, t_radix = 0, t_parallel = 0;
+    char buf[MAX_LEN + 1];
+
+    /* a quarter of the strings share the first 8 bytes, like URLs do */
+    srand(time(NULL));
+    for (size_t i = 0; i < ITEMS; ++i)
+    {
+        size_t len = MIN_LEN + rand() % (MAX_LEN - MIN_LEN + 1), j = 0;
+        if (i % 4 == 0)
+            for (; j < 8; ++j)
+                buf[j] = "https://"[j];
+        for (; j < len; ++j)
+            buf[j] = 'a' + rand() % 26;
+        buf[len] = 0;
+        xs_new(&input[i], buf);
+    }
+
+    for (int r = 0; r < ROUND; ++r)
+    {
+        xs_array a, b;
+        xs_array_init(&a);
+        xs_array_init(&b);
+        for (size_t i = 0; i < ITEMS; ++i)
+        {
+            xs_copy_to(&sorted[i], &input[i]);
+            xs_array_push(&a, &input[i]);
+            xs_array_push(&b, &input[i]);
+        }
+
+        clock_gettime(CLOCK_ID, &start);
+        qsort(sorted, ITEMS, sizeof(xs), cmp_xs);
+        clock_gettime(CLOCK_ID, &end);
+        t_qsort += elapsed(&start, &end);
+
+        clock_gettime(CLOCK_ID, &start);
+        xs_array_sort(&a, 1);
+        clock_gettime(CLOCK_ID, &end);
+        t_radix += elapsed(&start, &end);
+
+        clock_gettime(CLOCK_ID, &start);
+        xs_array_sort(&b, threads);
+        clock_gettime(CLOCK_ID, &end);
+        t_parallel += elapsed(&start, &end);
+
+        for (size_t i = 0; i < ITEMS; ++i)
+        {
+            if (!xs_equal(xs_array_at(&a, i), &sorted[i]) ||
+                !xs_equal(xs_array_at(&b, i), &sorted[i]))
+            {
+                fprintf(stderr, "mismatch at %zu\n", i);
+                return 1;
+            }
+            xs_free(&sorted[i]);
+        }
+        xs_array_free(&a);
+        xs_array_free(&b);
+    }
+
+    printf("# method ms/sort (%d strings of %d-%d bytes)\n", ITEMS, MIN_LEN,
+           MAX_LEN);
+    printf("qsort+strcmp %.2f\n", t_qsort / ROUND / 1e6);
+    printf("xs_array_sort %.2f\n", t_radix / ROUND / 1e6);
+    printf("xs_array_sort/%d %.2f\n", threads, t_parallel / ROUND / 1e6);
+
+    for (size_t i = 0; i < ITEMS; ++i)
+        xs_free(&input[i]);
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "xs.h"
+
+#define CLOCK_ID CLOCK_MONOTONIC_RAW
+#define ONE_SEC 1e9
+
+#define INPUT_SIZE (16 << 20)
+#define MAX_FIELD_LEN 64
+#define ROUND 10
+
+static char input[INPUT_SIZE + 1], scratch[INPUT_SIZE + 1];
+static xs fields[INPUT_SIZE / 2];
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) * ONE_SEC +
+           (end->tv_nsec - start->tv_nsec);
+}
+
+int main(int argc, char *argv[])
+{
+    struct timespec start = {0, 0};
+    struct timespec end = {0, 0};
+    double t_strtok = 0, t_tok = 0, t_split = 0;
+    size_t n = 0, count = 0;
+    xs in;
+
+    /* comma separated fields of 1 to MAX_FIELD_LEN bytes */
+    srand(time(NULL));
+    while (n < INPUT_SIZE)
+    {
+        size_t len = 1 + rand() % MAX_FIELD_LEN;
+        for (size_t i = 0; i < len && n < INPUT_SIZE; ++i)
+            input[n++] = 'a' + rand() % 26;
+        if (n < INPUT_SIZE)
+            input[n++] = ',';
+    }
+    input[INPUT_SIZE] = 0;
+    xs_new(&in, input);
+
+    for (int r = 0; r < ROUND; ++r)
+    {
+        char *saveptr;
+
+        /* strtok mutates its input, refresh it outside of the timing */
+        memcpy(scratch, input, sizeof(input));
+        clock_gettime(CLOCK_ID, &start);
+        count = 0;
+        for (char *p = strtok_r(scratch, ",", &saveptr); p;
+             p = strtok_r(NULL, ",", &saveptr))
+            xs_new(&fields[count++], p);
+        for (size_t i = 0; i < count; ++i)
+            xs_free(&fields[i]);
+        clock_gettime(CLOCK_ID, &end);
+        t_strtok += elapsed(&start, &end);
+
+        clock_gettime(CLOCK_ID, &start);
+        size_t pos = 0;
+        count = 0;
+        while (xs_tok(&fields[count], &in, ",", &pos))
+            ++count;
+        for (size_t i = 0; i < count; ++i)
+            xs_free(&fields[i]);
+        clock_gettime(CLOCK_ID, &end);
+        t_tok += elapsed(&start, &end);
+
+        clock_gettime(CLOCK_ID, &start);
+        count = xs_split(fields, sizeof(fields) / sizeof(fields[0]), &in, ',');
+        for (size_t i = 0; i < count; ++i)
+            xs_free(&fields[i]);
+        clock_gettime(CLOCK_ID, &end);
+        t_split += elapsed(&start, &end);
+    }
+
+    printf("# method ms/pass (%zu fields, %d MiB)\n", count, INPUT_SIZE >> 20);
+    printf("strtok+xs_new %.2f\n", t_strtok / ROUND / 1e6);
+    printf("xs_tok %.2f\n", t_tok / ROUND / 1e6);
+    printf("xs_split %.2f\n", t_split / ROUND / 1e6);
+
+    xs_free(&in);
+    return 0;
+}
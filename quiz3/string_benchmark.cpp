@@ -1,66 +1,124 @@
-#include <cstring>
 #include <string>
-#include <iostream>
-#include <ctime>
-#include <unistd.h>
 
-#define CLOCK_ID CLOCK_MONOTONIC_RAW
-#define ONE_SEC 1e9
+#include "suite.h"
 
-#define SIZE 131072
-
-// https://stackoverflow.com/questions/822323/how-to-generate-a-random-int-in-c
-std::string gen_random(const int len)
+struct ctx_t
 {
+    std::string s[SUITE_ITEMS], c[SUITE_ITEMS];
+};
 
-    std::string tmp_s;
-    static const char alphanum[] =
-        "0123456789"
-        "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-        "abcdefghijklmnopqrstuvwxyz";
-
-    srand((unsigned)time(NULL) * getpid());
+static const std::string prefix = "<<", suffix = ">>";
 
-    tmp_s.reserve(len);
+static void *ctx_create(void) { return new ctx_t; }
 
-    for (int i = 0; i < len; ++i)
-        tmp_s += alphanum[rand() % (sizeof(alphanum) - 1)];
+static void ctx_destroy(void *ctx) { delete (ctx_t *)ctx; }
 
-    return tmp_s;
+static void new_all(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+        x->s[i] = suite_input[d][i];
 }
 
-int main(int argc, char *argv[])
+static void new_padded_all(void *ctx, int d)
 {
-    size_t count;
-    std::string str[SIZE];
-    int32_t *tmp[SIZE] = {0};
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+        x->s[i] = suite_padded[d][i];
+}
 
-    struct timespec start = {0, 0};
-    struct timespec end = {0, 0};
+static void new_copy_all(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    new_all(ctx, d);
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+        x->c[i] = x->s[i];
+}
 
-    for (int i = 0; i < SIZE; ++i)
+/* release the buffers like xs_free does, the objects stay */
+static void free_all(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
     {
-        str[i] = gen_random(20);
-        tmp[i] = new int(0);
+        std::string().swap(x->s[i]);
+        std::string().swap(x->c[i]);
     }
+}
 
-    for (int i = 0; i < SIZE; ++i)
-    {
-        ++*tmp[i];
-    }
+static void run_construct(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+        new (&x->s[i]) std::string(suite_input[d][i]);
+}
 
-    clock_gettime(CLOCK_ID, &start);
-    for (int i = 0; i < 1000; ++i)
+/* run_construct builds the objects again in place */
+static void destruct_all(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+        x->s[i].~basic_string();
+}
+
+static void run_copy(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+        x->c[i] = x->s[i];
+}
+
+static void run_write(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+        x->c[i] += suffix;
+}
+
+static void run_concat(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
     {
-        str[rand() % SIZE][20] = 'A';
+        x->s[i].insert(0, prefix);
+        x->s[i] += suffix;
     }
-    clock_gettime(CLOCK_ID, &end);
-    long long utime = (double)(end.tv_sec - start.tv_sec) * ONE_SEC + (end.tv_nsec - start.tv_nsec);
-    std::cout << utime << std::endl;
+}
 
-    for (int i = 0; i < SIZE; ++i)
+static void run_trim(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
     {
-        delete tmp[i];
+        std::string &s = x->s[i];
+        size_t end = s.find_last_not_of(' ');
+        s.erase(end == std::string::npos ? 0 : end + 1);
+        s.erase(0, s.find_first_not_of(' '));
     }
-    return 0;
-}
\ No newline at end of file
+}
+
+static void run_grow(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+        x->s[i].reserve(2 * x->s[i].size() + 1);
+}
+
+static void run_free(void *ctx, int d) { free_all(ctx, d); }
+
+static const suite_op ops[] = {
+    {"construct", destruct_all, run_construct, free_all},
+    {"copy", new_all, run_copy, free_all},
+    {"cow_write", new_copy_all, run_write, free_all},
+    {"concat", new_all, run_concat, free_all},
+    {"trim", new_padded_all, run_trim, free_all},
+    {"grow", new_all, run_grow, free_all},
+    {"free", new_all, run_free, NULL},
+};
+
+int main(int argc, char *argv[])
+{
+    const suite_ctx ctx = {ctx_create, ctx_destroy};
+    return suite_main("string", ops, sizeof(ops) / sizeof(ops[0]), &ctx, argc,
+                      argv);
+}
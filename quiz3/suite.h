@@ -0,0 +1,227 @@
+#pragma once
+/* Harness shared by xs_benchmark.c and string_benchmark.cpp.
+ *
+ * Every operation runs on SUITE_ITEMS strings per thread and per round, with
+ * inputs drawn from one length distribution. Setup and teardown of a round
+ * are not timed. Each line of output is
+ *
+ *   impl op dist threads ns/op ci95(ns) cache-misses/op
+ *
+ * where ns/op is the mean over SUITE_ROUNDS rounds of the slowest thread
+ * and ci95 the half width of its 95% confidence interval. cache-misses/op
+ * is nan when perf events are not available.
+ */
+#include <linux/perf_event.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CLOCK_ID CLOCK_MONOTONIC_RAW
+#define ONE_SEC 1e9
+
+#define SUITE_ROUNDS 30
+/* Student's t for 95% and SUITE_ROUNDS - 1 degrees of freedom */
+#define SUITE_T95 2.045
+#define SUITE_ITEMS 4096
+#define SUITE_MAX_LEN 4096
+/* trim inputs get this many spaces on each side */
+#define SUITE_PAD 8
+
+typedef struct
+{
+    const char *name;
+    size_t min_len, max_len;
+} suite_dist;
+
+/* the short, medium and large classes of xs */
+static const suite_dist suite_dists[] = {
+    {"short", 1, 31},
+    {"medium", 32, 255},
+    {"large", 256, SUITE_MAX_LEN},
+};
+#define SUITE_DISTS (sizeof(suite_dists) / sizeof(suite_dists[0]))
+
+/* per thread state, SUITE_ITEMS strings of the implementation */
+typedef struct
+{
+    void *(*create)(void);
+    void (*destroy)(void *ctx);
+} suite_ctx;
+
+typedef struct
+{
+    const char *name;
+    void (*setup)(void *ctx, int dist);
+    void (*run)(void *ctx, int dist);
+    void (*teardown)(void *ctx, int dist);
+} suite_op;
+
+/* inputs and inputs padded with spaces, shared read-only by all threads */
+static char *suite_input[SUITE_DISTS][SUITE_ITEMS];
+static char *suite_padded[SUITE_DISTS][SUITE_ITEMS];
+
+static void suite_gen_inputs(void)
+{
+    srand(1);
+    for (size_t d = 0; d < SUITE_DISTS; ++d)
+    {
+        for (int i = 0; i < SUITE_ITEMS; ++i)
+        {
+            size_t len = suite_dists[d].min_len +
+                         rand() % (suite_dists[d].max_len -
+                                   suite_dists[d].min_len + 1);
+            char *s = (char *)malloc(len + 1);
+            char *p = (char *)malloc(len + 2 * SUITE_PAD + 1);
+            for (size_t j = 0; j < len; ++j)
+                s[j] = 'a' + rand() % 26;
+            s[len] = 0;
+            memset(p, ' ', len + 2 * SUITE_PAD);
+            memcpy(p + SUITE_PAD, s, len);
+            p[len + 2 * SUITE_PAD] = 0;
+            suite_input[d][i] = s;
+            suite_padded[d][i] = p;
+        }
+    }
+}
+
+static int suite_perf_open(void)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    /* this thread only, on any CPU */
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+typedef struct
+{
+    const suite_op *op;
+    int dist;
+    const suite_ctx *ctx;
+    pthread_barrier_t *barrier;
+    double ns[SUITE_ROUNDS];
+    double misses;
+    int perf_ok;
+} suite_worker;
+
+static void *suite_worker_main(void *arg)
+{
+    suite_worker *w = (suite_worker *)arg;
+    void *ctx = w->ctx->create();
+    int fd = suite_perf_open();
+    struct timespec start, end;
+
+    w->perf_ok = fd >= 0;
+    w->misses = 0;
+    for (int r = 0; r < SUITE_ROUNDS; ++r)
+    {
+        uint64_t count = 0;
+        if (w->op->setup)
+            w->op->setup(ctx, w->dist);
+        if (fd >= 0)
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+
+        pthread_barrier_wait(w->barrier);
+        if (fd >= 0)
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        clock_gettime(CLOCK_ID, &start);
+        w->op->run(ctx, w->dist);
+        clock_gettime(CLOCK_ID, &end);
+        if (fd >= 0)
+        {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd, &count, sizeof(count)) == sizeof(count))
+                w->misses += count;
+        }
+
+        w->ns[r] = (double)(end.tv_sec - start.tv_sec) * ONE_SEC +
+                   (end.tv_nsec - start.tv_nsec);
+        if (w->op->teardown)
+            w->op->teardown(ctx, w->dist);
+        pthread_barrier_wait(w->barrier);
+    }
+
+    if (fd >= 0)
+        close(fd);
+    w->ctx->destroy(ctx);
+    return NULL;
+}
+
+static void suite_measure(const char *impl, const suite_op *op, int dist,
+                          int nthreads, const suite_ctx *ctx)
+{
+    pthread_t threads[nthreads];
+    suite_worker workers[nthreads];
+    pthread_barrier_t barrier;
+    double ns[SUITE_ROUNDS], mean = 0, var = 0, misses = 0;
+    int perf_ok = 1;
+
+    pthread_barrier_init(&barrier, NULL, nthreads);
+    for (int t = 0; t < nthreads; ++t)
+    {
+        workers[t].op = op;
+        workers[t].dist = dist;
+        workers[t].ctx = ctx;
+        workers[t].barrier = &barrier;
+        pthread_create(&threads[t], NULL, suite_worker_main, &workers[t]);
+    }
+    for (int t = 0; t < nthreads; ++t)
+        pthread_join(threads[t], NULL);
+    pthread_barrier_destroy(&barrier);
+
+    /* a round lasts as long as its slowest thread */
+    for (int r = 0; r < SUITE_ROUNDS; ++r)
+    {
+        ns[r] = 0;
+        for (int t = 0; t < nthreads; ++t)
+            if (workers[t].ns[r] > ns[r])
+                ns[r] = workers[t].ns[r];
+        ns[r] /= SUITE_ITEMS;
+        mean += ns[r];
+    }
+    mean /= SUITE_ROUNDS;
+    for (int r = 0; r < SUITE_ROUNDS; ++r)
+        var += (ns[r] - mean) * (ns[r] - mean);
+    var /= SUITE_ROUNDS - 1;
+
+    for (int t = 0; t < nthreads; ++t)
+    {
+        perf_ok &= workers[t].perf_ok;
+        misses += workers[t].misses;
+    }
+    misses /= (double)SUITE_ROUNDS * SUITE_ITEMS * nthreads;
+
+    printf("%s %s %s %d %.2f %.2f %.3f\n", impl, op->name,
+           suite_dists[dist].name, nthreads, mean,
+           SUITE_T95 * sqrt(var / SUITE_ROUNDS), perf_ok ? misses : NAN);
+    fflush(stdout);
+}
+
+/* usage: prog [max threads [min threads]], each thread count in between is
+ * measured
+ */
+static int suite_main(const char *impl, const suite_op *ops, size_t nops,
+                      const suite_ctx *ctx, int argc, char *argv[])
+{
+    int max_threads = argc > 1 ? atoi(argv[1]) : 1;
+    int min_threads = argc > 2 ? atoi(argv[2]) : 1;
+
+    suite_gen_inputs();
+    for (int t = min_threads; t <= max_threads; ++t)
+        for (size_t o = 0; o < nops; ++o)
+            for (size_t d = 0; d < SUITE_DISTS; ++d)
+                suite_measure(impl, &ops[o], d, t, ctx);
+    return 0;
+}
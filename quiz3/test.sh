@@ -4,8 +4,9 @@ ORIG_ASLR=$(cat /proc/sys/kernel/randomize_va_space)
 ORIG_GOV=$(cat /sys/devices/system/cpu/cpu$CPUID/cpufreq/scaling_governor)
 sudo bash -c "echo 0 > /proc/sys/kernel/randomize_va_space"
 sudo bash -c "echo performance > /sys/devices/system/cpu/cpu$CPUID/cpufreq/scaling_governor"
-sudo perf stat -e cache-misses:u taskset -c $CPUID ./xs>/dev/null
-sudo perf stat -e cache-misses:u taskset -c $CPUID ./string>/dev/null
+sudo perf stat -e cache-misses:u taskset -c $CPUID ./xs_benchmark 1 >/dev/null
+sudo perf stat -e cache-misses:u taskset -c $CPUID ./string_benchmark 1 >/dev/null
+sudo perf stat -e cache-misses:u taskset -c $CPUID ./xs_string_benchmark 1 >/dev/null
 python3 driver.py
 gnuplot plot.gp
 sudo bash -c "echo $ORIG_ASLR > /proc/sys/kernel/randomize_va_space"
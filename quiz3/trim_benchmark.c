@@ -0,0 +1,82 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "xs.h"
+
+#define CLOCK_ID CLOCK_MONOTONIC_RAW
+#define ONE_SEC 1e9
+
+#define MIN_LEN 32
+#define MAX_LEN (64 << 10)
+#define ROUND 2000
+
+static const char *trimsets[] = {" ", " \t\r\n", " \t\r\n\v\f.,",
+                                 " \t\r\n\v\f.,;:!?-_/|"};
+
+/* A log line with a quarter of its bytes trimmed on each side */
+static void gen_line(char *buf, size_t len, const char *trimset)
+{
+    size_t nset = strlen(trimset), pad = len / 4;
+    for (size_t i = 0; i < len; ++i)
+    {
+        if (i < pad || i >= len - pad)
+            buf[i] = trimset[rand() % nset];
+        else
+            buf[i] = 'a' + rand() % 26;
+    }
+    buf[len] = 0;
+}
+
+static double run(const char *line, size_t len, const char *trimset, int level)
+{
+    struct timespec start = {0, 0};
+    struct timespec end = {0, 0};
+    xs s;
+
+    xs_simd = level;
+    xs_new(&s, line);
+
+    clock_gettime(CLOCK_ID, &start);
+    for (int i = 0; i < ROUND; ++i)
+    {
+        /* restore the untrimmed line, it is the same cost for every level */
+        memcpy(xs_data(&s), line, len + 1);
+        s.size = len;
+        xs_trim(&s, trimset);
+    }
+    clock_gettime(CLOCK_ID, &end);
+
+    xs_free(&s);
+    return ((double)(end.tv_sec - start.tv_sec) * ONE_SEC +
+            (end.tv_nsec - start.tv_nsec)) /
+           ROUND;
+}
+
+int main(int argc, char *argv[])
+{
+    static char line[MAX_LEN + 1];
+    int max_level = xs_simd_level();
+
+    srand(time(NULL));
+
+    printf("# len trimset_size scalar(ns) sse2(ns) avx2(ns)\n");
+    for (size_t t = 0; t < sizeof(trimsets) / sizeof(trimsets[0]); ++t)
+    {
+        for (size_t len = MIN_LEN; len <= MAX_LEN; len <<= 1)
+        {
+            gen_line(line, len, trimsets[t]);
+            printf("%zu %zu", len, strlen(trimsets[t]));
+            for (int level = XS_SIMD_NONE; level <= XS_SIMD_AVX2; ++level)
+            {
+                if (level > max_level)
+                    printf(" -");
+                else
+                    printf(" %.1f", run(line, len, trimsets[t], level));
+            }
+            printf("\n");
+        }
+        printf("\n");
+    }
+    return 0;
+}
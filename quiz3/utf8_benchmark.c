@@ -0,0 +1,90 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "xs.h"
+
+#define CLOCK_ID CLOCK_MONOTONIC_RAW
+#define ONE_SEC 1e9
+
+#define PAYLOAD_SIZE (1 << 20)
+#define ROUND 200
+#define SHORT_CHECKS (1 << 22)
+
+static const struct
+{
+    const char *name, *text;
+} corpora[] = {
+    {"ascii", "The quick brown fox jumps over the lazy dog. "},
+    {"latin", "Le cœur déçu mais l'âme plutôt naïve, Louÿs rêva. "},
+    {"cjk", "敏捷的棕色狐狸跳过了懒狗。"},
+    {"emoji", "😀 😃 😄 😁 😆 😅 🤣 😂 🙂 🙃 "},
+};
+
+static char payload[PAYLOAD_SIZE + 4];
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) * ONE_SEC +
+           (end->tv_nsec - start->tv_nsec);
+}
+
+int main(int argc, char *argv[])
+{
+    struct timespec start = {0, 0};
+    struct timespec end = {0, 0};
+    static const char *names[] = {"scalar", "sse2", "avx2"};
+    int level = xs_simd_level();
+    size_t sum = 0;
+
+    printf("# corpus method GB/s (%d KiB payload)\n", PAYLOAD_SIZE >> 10);
+    for (size_t c = 0; c < sizeof(corpora) / sizeof(corpora[0]); ++c)
+    {
+        /* repeat the text, cut at a code point boundary */
+        size_t n = 0, len = strlen(corpora[c].text);
+        while (n + len <= PAYLOAD_SIZE)
+        {
+            memcpy(payload + n, corpora[c].text, len);
+            n += len;
+        }
+        xs x;
+        xs_new_len(&x, payload, n);
+
+        for (int l = XS_SIMD_NONE; l <= level; ++l)
+        {
+            xs_simd = l;
+            clock_gettime(CLOCK_ID, &start);
+            for (int r = 0; r < ROUND; ++r)
+                sum += xs_utf8_valid(&x) + xs_utf8_length(&x);
+            clock_gettime(CLOCK_ID, &end);
+            printf("%s %s %.2f\n", corpora[c].name, names[l],
+                   (double)n * ROUND / elapsed(&start, &end));
+        }
+        xs_simd = level;
+        xs_free(&x);
+    }
+
+    /* the first check of a short ASCII string marks it */
+    xs s;
+    xs_new(&s, "content-type");
+    clock_gettime(CLOCK_ID, &start);
+    for (int r = 0; r < SHORT_CHECKS; ++r)
+    {
+        s.flag2 = 0;
+        sum += xs_utf8_valid(&s);
+        __asm__ volatile("" : : "r"(&s) : "memory");
+    }
+    clock_gettime(CLOCK_ID, &end);
+    printf("# short ascii ns/check (checksum %zu)\n", sum);
+    printf("unmarked %.2f\n", elapsed(&start, &end) / SHORT_CHECKS);
+
+    clock_gettime(CLOCK_ID, &start);
+    for (int r = 0; r < SHORT_CHECKS; ++r)
+    {
+        sum += xs_utf8_valid(&s);
+        __asm__ volatile("" : : "r"(&s) : "memory");
+    }
+    clock_gettime(CLOCK_ID, &end);
+    printf("marked %.2f\n", elapsed(&start, &end) / SHORT_CHECKS);
+    return sum == 0;
+}
@@ -1,3 +1,5 @@
+#pragma once
+#include <fcntl.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -5,13 +7,38 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define XS_HAVE_X86
+#endif
+
+/* Global state, such as the allocator hook and the scope arenas, is
+ * defined in the headers as weak symbols: every translation unit including
+ * them emits a definition, the linker keeps one and they all share it.
+ */
+#define XS_SHARED __attribute__((weak))
+
 #define MAX_STR_LEN_BITS (54)
 #define MAX_STR_LEN ((1UL << MAX_STR_LEN_BITS) - 1)
 
 #define LARGE_STRING_LEN 256
 
+/* large strings keep their reference count and a cached hash, 0 until it is
+ * computed, in front of the data
+ */
+#define XS_HEADER_SIZE 8
+
+/* Buffers from this size on are anonymous mappings grown with mremap, which
+ * moves pages instead of copying the data. The header layout is unchanged.
+ */
+#if defined(__linux__) && defined(MREMAP_MAYMOVE)
+#define XS_HUGE_STRING_LEN ((size_t)4 << 20)
+#endif
+
 #define XS_32
 #ifdef XS_32
 #define SHORT_STRING_LEN 31
@@ -37,11 +64,18 @@ typedef union
 #ifdef XS_32
             space_left : 5,
             /* if it is on heap, set to 1 */
-            is_ptr : 1, is_large_string : 1, flag2 : 1;
+            is_ptr : 1, is_large_string : 1,
+            /* two meanings, after is_ptr: static storage on the heap side,
+             * see xs_is_static, and known ASCII for a short string, see
+             * xs_utf8_valid
+             */
+            flag2 : 1;
 #else
             space_left : 4,
             /* if it is on heap, set to 1 */
-            is_ptr : 1, is_large_string : 1, flag2 : 1, flag3 : 1;
+            is_ptr : 1, is_large_string : 1,
+            /* as above */
+            flag2 : 1, flag3 : 1;
 #endif
     };
 
@@ -54,6 +88,14 @@ typedef union
         /* capacity is always a power of 2 (unsigned)-1 */
 #ifdef XS_32
                       capacity : 7;
+        /* a slice reads [offset, offset + size) of a shared large string */
+        size_t offset : MAX_STR_LEN_BITS, is_slice : 1,
+            /* the buffer is a file mapping, see xs_from_file */
+            is_mapped : 1,
+            /* the buffer belongs to a scope arena, see xs_scope_begin */
+            is_arena : 1,
+            /* the buffer is held by the intern table, see xs_intern.h */
+            is_interned : 1;
 #else
                       capacity : 6;
         /* the last 4 bits are important flags */
@@ -61,6 +103,36 @@ typedef union
     };
 } xs;
 
+/* Instruction set used by the vectorized paths, probed once at runtime.
+ * Benchmarks may pin xs_simd to a lower level to compare implementations.
+ */
+enum
+{
+    XS_SIMD_NONE = 0,
+    XS_SIMD_SSE2,
+    XS_SIMD_AVX2,
+};
+
+XS_SHARED int xs_simd = -1;
+
+static inline int xs_simd_level(void)
+{
+    int level = __atomic_load_n(&xs_simd, __ATOMIC_RELAXED);
+    if (level >= 0)
+        return level;
+
+    level = XS_SIMD_NONE;
+#ifdef XS_HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        level = XS_SIMD_AVX2;
+    else if (__builtin_cpu_supports("sse2"))
+        level = XS_SIMD_SSE2;
+#endif
+    __atomic_store_n(&xs_simd, level, __ATOMIC_RELAXED);
+    return level;
+}
+
 static inline bool xs_is_ptr(const xs *x) { return x->is_ptr; }
 
 static inline bool xs_is_large_string(const xs *x)
@@ -68,6 +140,51 @@ static inline bool xs_is_large_string(const xs *x)
     return x->is_large_string;
 }
 
+/* Slices need the spare bytes of the 32-byte layout */
+static inline bool xs_is_slice(const xs *x)
+{
+#ifdef XS_32
+    return xs_is_ptr(x) && xs_is_large_string(x) && x->is_slice;
+#else
+    return false;
+#endif
+}
+
+static inline bool xs_is_mapped(const xs *x)
+{
+#ifdef XS_32
+    return xs_is_slice(x) && x->is_mapped;
+#else
+    return false;
+#endif
+}
+
+/* flag2 of a heap string: the data is static storage that xs does not own,
+ * see xs_literal
+ */
+static inline bool xs_is_static(const xs *x)
+{
+    return xs_is_ptr(x) && x->flag2;
+}
+
+static inline bool xs_is_interned(const xs *x)
+{
+#ifdef XS_32
+    return xs_is_ptr(x) && x->is_interned;
+#else
+    return false;
+#endif
+}
+
+static inline bool xs_is_arena(const xs *x)
+{
+#ifdef XS_32
+    return xs_is_ptr(x) && x->is_arena;
+#else
+    return false;
+#endif
+}
+
 static inline size_t xs_size(const xs *x)
 {
     return xs_is_ptr(x) ? x->size : SHORT_STRING_LEN - x->space_left;
@@ -78,101 +195,442 @@ static inline char *xs_data(const xs *x)
     if (!xs_is_ptr(x))
         return (char *)x->data;
 
+    if (xs_is_slice(x))
+        return (char *)(x->ptr + XS_HEADER_SIZE + x->offset);
     if (xs_is_large_string(x))
-        return (char *)(x->ptr + 4); // OFF
+        return (char *)(x->ptr + XS_HEADER_SIZE); // OFF
     return (char *)x->ptr;
 }
 
+/* Slices and static strings do not own the bytes after them, any growth has
+ * to copy them out
+ */
 static inline size_t xs_capacity(const xs *x)
 {
+    if (xs_is_slice(x) || xs_is_static(x))
+        return x->size;
     return xs_is_ptr(x) ? ((size_t)1 << x->capacity) - 1 : SHORT_STRING_LEN;
 }
 
+/* bytes actually allocated for a heap string */
+static inline size_t xs_buffer_size(const xs *x)
+{
+    return ((size_t)1 << x->capacity) +
+           (xs_is_large_string(x) ? XS_HEADER_SIZE : 0);
+}
+
+/* Heap buffers of medium and large strings go through these hooks. The
+ * buffer size is always known from the capacity and is handed back on
+ * realloc and free, so a pool allocator needs no per-block header.
+ * Switch allocators only while no heap string is alive.
+ */
+typedef struct
+{
+    void *(*alloc)(size_t size);
+    void *(*realloc)(void *ptr, size_t old_size, size_t size);
+    void (*free)(void *ptr, size_t size);
+} xs_allocator;
+
+static void *xs_libc_alloc(size_t size) { return malloc(size); }
+
+static void *xs_libc_realloc(void *ptr, size_t old_size, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+static void xs_libc_free(void *ptr, size_t size) { free(ptr); }
+
+static const xs_allocator xs_libc_allocator = {
+    .alloc = xs_libc_alloc,
+    .realloc = xs_libc_realloc,
+    .free = xs_libc_free,
+};
+
+/* One for the program, see XS_SHARED */
+XS_SHARED const xs_allocator *xs_allocator_hook = &xs_libc_allocator;
+
+/* NULL restores malloc/realloc/free */
+static inline void xs_set_allocator(const xs_allocator *a)
+{
+    xs_allocator_hook = a ? a : &xs_libc_allocator;
+}
+
+/* Scoped arena for temporaries.
+ *
+ * Between xs_scope_begin and xs_scope_end, every heap buffer a thread
+ * creates for a string that had none is bumped from that thread's arena
+ * instead, and xs_free on it does nothing. xs_scope_end releases all of
+ * them at once. Strings that already own a heap buffer keep using the
+ * allocator when they grow.
+ *
+ * This includes short strings that outgrow the inline buffer and shared
+ * strings copied on write. Any of them that outlives the scope must be
+ * passed to xs_escape, which moves it to a heap buffer. Scopes nest, and
+ * arena strings must not cross threads.
+ */
+#define XS_ARENA_CHUNK (64 << 10)
+
+typedef struct xs_arena_chunk
+{
+    struct xs_arena_chunk *prev;
+    size_t size;
+    max_align_t data[];
+} xs_arena_chunk;
+
+typedef struct
+{
+    xs_arena_chunk *chunk;
+    char *cur;
+} xs_scope;
+
+struct xs_arena_state
+{
+    xs_arena_chunk *chunk, *spare;
+    char *cur, *end;
+    int depth;
+};
+
+XS_SHARED __thread struct xs_arena_state xs_arena;
+
+static inline void xs_scope_begin(xs_scope *scope)
+{
+    scope->chunk = xs_arena.chunk;
+    scope->cur = xs_arena.cur;
+    xs_arena.depth++;
+}
+
+static inline void xs_scope_end(const xs_scope *scope)
+{
+    while (xs_arena.chunk != scope->chunk)
+    {
+        xs_arena_chunk *c = xs_arena.chunk;
+        xs_arena.chunk = c->prev;
+        /* keep one chunk around, so that a scope does not have to malloc */
+        if (c->size == XS_ARENA_CHUNK && !xs_arena.spare)
+            xs_arena.spare = c;
+        else
+            free(c);
+    }
+    xs_arena.cur = scope->cur;
+    xs_arena.end =
+        scope->chunk ? (char *)scope->chunk->data + scope->chunk->size : NULL;
+    xs_arena.depth--;
+}
+
+static void *xs_arena_alloc(size_t size)
+{
+    size = (size + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1);
+    if ((size_t)(xs_arena.end - xs_arena.cur) < size)
+    {
+        size_t chunk_size = size > XS_ARENA_CHUNK / 4 ? size : XS_ARENA_CHUNK;
+        xs_arena_chunk *c = xs_arena.spare;
+        if (c && chunk_size == XS_ARENA_CHUNK)
+            xs_arena.spare = NULL;
+        else if (!(c = (xs_arena_chunk *)malloc(sizeof(*c) + chunk_size)))
+            return NULL;
+        c->prev = xs_arena.chunk;
+        c->size = chunk_size;
+        xs_arena.chunk = c;
+        xs_arena.cur = (char *)c->data;
+        xs_arena.end = xs_arena.cur + chunk_size;
+    }
+    void *p = xs_arena.cur;
+    xs_arena.cur += size;
+    return p;
+}
+
+/* The most recent block is extended in place, others are copied */
+static void *xs_arena_realloc(void *ptr, size_t old_size, size_t size)
+{
+    size_t old_round =
+        (old_size + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1);
+    if ((char *)ptr + old_round == xs_arena.cur &&
+        (size_t)(xs_arena.end - (char *)ptr) >= size)
+    {
+        xs_arena.cur = (char *)ptr;
+        return xs_arena_alloc(size);
+    }
+    void *p = xs_arena_alloc(size);
+    if (p)
+        memcpy(p, ptr, old_size < size ? old_size : size);
+    return p;
+}
+
+/* Large strings may be shared across threads when XS_ATOMIC_REFCNT is
+ * defined. The decrement releases our writes to the buffer and the thread
+ * dropping the last reference acquires them before freeing it, the same
+ * scheme as std::shared_ptr.
+ */
+static inline int *xs_refcnt(const xs *x)
+{
+    return (int *)((size_t)x->ptr);
+}
+
 static inline void xs_set_refcnt(const xs *x, int val)
 {
-    *((int *)((size_t)x->ptr)) = val;
+#ifdef XS_ATOMIC_REFCNT
+    __atomic_store_n(xs_refcnt(x), val, __ATOMIC_RELAXED);
+#else
+    *xs_refcnt(x) = val;
+#endif
 }
 
 static inline void xs_inc_refcnt(const xs *x)
 {
-    if (xs_is_large_string(x))
-        ++(*(int *)((size_t)x->ptr));
+    if (!xs_is_large_string(x))
+        return;
+#ifdef XS_ATOMIC_REFCNT
+    /* the caller already owns a reference, nothing to synchronize with */
+    __atomic_add_fetch(xs_refcnt(x), 1, __ATOMIC_RELAXED);
+#else
+    ++(*xs_refcnt(x));
+#endif
 }
 
 static inline int xs_dec_refcnt(const xs *x)
 {
     if (!xs_is_large_string(x))
         return 0;
-    return --(*(int *)((size_t)x->ptr));
+#ifdef XS_ATOMIC_REFCNT
+    int ref = __atomic_sub_fetch(xs_refcnt(x), 1, __ATOMIC_RELEASE);
+    if (ref == 0)
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return ref;
+#else
+    return --(*xs_refcnt(x));
+#endif
 }
 
 static inline int xs_get_refcnt(const xs *x)
 {
     if (!xs_is_large_string(x))
         return 0;
-    return *(int *)((size_t)x->ptr);
+#ifdef XS_ATOMIC_REFCNT
+    /* seeing 1 means the other owners are gone, acquire their writes */
+    return __atomic_load_n(xs_refcnt(x), __ATOMIC_ACQUIRE);
+#else
+    return *xs_refcnt(x);
+#endif
+}
+
+/* The cached hash belongs to the whole buffer, slices do not use it */
+static inline uint32_t *xs_hash_cache(const xs *x)
+{
+    return (uint32_t *)((size_t)x->ptr + sizeof(int));
+}
+
+static inline void xs_set_hash_cache(const xs *x, uint32_t hash)
+{
+#ifdef XS_ATOMIC_REFCNT
+    /* racing writers store the same value */
+    __atomic_store_n(xs_hash_cache(x), hash, __ATOMIC_RELAXED);
+#else
+    *xs_hash_cache(x) = hash;
+#endif
+}
+
+static inline uint32_t xs_get_hash_cache(const xs *x)
+{
+#ifdef XS_ATOMIC_REFCNT
+    return __atomic_load_n(xs_hash_cache(x), __ATOMIC_RELAXED);
+#else
+    return *xs_hash_cache(x);
+#endif
+}
+
+/* To be called by everything that changes the content of a string. Drops
+ * the cached hash of a large string and the ASCII mark of a short one, see
+ * xs_utf8_valid.
+ */
+static inline void xs_invalidate_caches(xs *x)
+{
+    if (!xs_is_ptr(x))
+        x->flag2 = 0;
+    else if (xs_is_large_string(x) && !xs_is_slice(x))
+        xs_set_hash_cache(x, 0);
 }
 
 #define xs_literal_empty() \
     (xs) { .space_left = SHORT_STRING_LEN }
 
 /* lowerbound (floor log2) */
-static inline int ilog2(uint32_t n) { return 32 - __builtin_clz(n) - 1; } // LLL
+static inline int ilog2(size_t n)
+{
+    return 8 * sizeof(unsigned long) - __builtin_clzl(n) - 1;
+} // LLL
+
+static inline bool xs_is_huge(const xs *x)
+{
+#ifdef XS_HUGE_STRING_LEN
+    return xs_is_large_string(x) && !xs_is_arena(x) &&
+           ((size_t)1 << x->capacity) >= XS_HUGE_STRING_LEN;
+#else
+    return false;
+#endif
+}
 
-static void xs_allocate_data(xs *x, size_t len, bool reallocate)
+#ifdef XS_HUGE_STRING_LEN
+/* Map or remap a huge buffer. A smaller heap buffer is copied over once. */
+static void *xs_huge_map(void *old, size_t old_size, size_t size)
 {
-    /* Medium string */
-    if (len < LARGE_STRING_LEN)
+    void *p;
+    if (old_size >= XS_HUGE_STRING_LEN + XS_HEADER_SIZE)
     {
-        x->ptr = reallocate ? realloc(x->ptr, (size_t)1 << x->capacity)
-                            : malloc((size_t)1 << x->capacity);
-        return;
+        p = mremap(old, old_size, size, MREMAP_MAYMOVE);
+        return p == MAP_FAILED ? NULL : p;
     }
 
-    /* Large string */
-    x->is_large_string = 1;
+    p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+             -1, 0);
+    if (p == MAP_FAILED)
+        return NULL;
+    if (old_size)
+    {
+        memcpy(p, old, old_size);
+        xs_allocator_hook->free(old, old_size);
+    }
+    return p;
+}
+#endif
+
+static void *xs_resize_buffer(void *ptr, bool arena, size_t old_size,
+                              size_t size)
+{
+    if (arena)
+        return old_size ? xs_arena_realloc(ptr, old_size, size)
+                        : xs_arena_alloc(size);
+    return old_size ? xs_allocator_hook->realloc(ptr, old_size, size)
+                    : xs_allocator_hook->alloc(size);
+}
+
+/* Allocate the buffer for the current capacity. When growing, old_size is
+ * the size of the buffer being replaced, 0 means there is none. On failure
+ * false is returned and x, the old buffer included, is left alone.
+ */
+static bool xs_allocate_data(xs *x, size_t len, size_t old_size)
+{
+    size_t cap = (size_t)1 << x->capacity;
+    bool arena = false;
+    char *ptr;
+
+#ifdef XS_32
+    /* a new buffer inside a scope is a temporary, an old one stays put */
+    arena = old_size ? x->is_arena : xs_arena.depth > 0;
+#endif
+
+    /* Medium string, unless it already has a header, see xs_intern */
+    bool large = len >= LARGE_STRING_LEN || (old_size && xs_is_large_string(x));
+    /* The extra bytes of large strings are used to store the reference
+     * count
+     */
+    if (!large)
+        ptr = (char *)xs_resize_buffer(x->ptr, arena, old_size, cap);
+#ifdef XS_HUGE_STRING_LEN
+    else if (cap >= XS_HUGE_STRING_LEN && !arena)
+        ptr = (char *)xs_huge_map(x->ptr, old_size, cap + XS_HEADER_SIZE);
+#endif
+    else
+        ptr = (char *)xs_resize_buffer(x->ptr, arena, old_size,
+                                       cap + XS_HEADER_SIZE);
+    if (!ptr)
+        return false;
+
+    x->flag2 = 0;
+#ifdef XS_32
+    x->is_arena = arena;
+    /* whatever was there belonged to a short string or a slice */
+    x->offset = 0;
+    x->is_slice = 0;
+    x->is_mapped = 0;
+    x->is_interned = 0;
+#endif
+    bool was_medium = old_size && !xs_is_large_string(x);
+    x->ptr = ptr;
+    /* a shrunk large string being copied out loses its refcount */
+    x->is_large_string = large;
+    if (!large)
+        return true;
 
-    /* The extra 4 bytes are used to store the reference count */
-    x->ptr = reallocate ? realloc(x->ptr, (size_t)(1 << x->capacity) + 4)
-                        : malloc((size_t)(1 << x->capacity) + 4);
+    /* make room for the header in front of the medium string data */
+    if (was_medium)
+        memmove(x->ptr + XS_HEADER_SIZE, x->ptr, old_size);
 
     xs_set_refcnt(x, 1);
+    xs_set_hash_cache(x, 0);
+    return true;
 }
 
-xs *xs_new(xs *x, const void *p)
+/* like xs_new, for data that is not NUL-terminated or contains NUL bytes */
+static inline xs *xs_new_len(xs *x, const void *p, size_t len)
 {
     *x = xs_literal_empty();
-    size_t len = strlen(p) + 1;
-    if (len > SHORT_STRING_LEN + 1)
+    if (len > SHORT_STRING_LEN)
     {
-        x->capacity = ilog2(len) + 1;
-        x->size = len - 1;
+        x->capacity = ilog2(len + 1) + 1;
+        x->size = len;
         x->is_ptr = true;
         xs_allocate_data(x, x->size, 0);
         memcpy(xs_data(x), p, len);
+        xs_data(x)[len] = 0;
     }
     else
     {
         memcpy(x->data, p, len);
-        x->space_left = SHORT_STRING_LEN - (len - 1);
+        x->data[len] = 0;
+        x->space_left = SHORT_STRING_LEN - len;
+    }
+    return x;
+}
+
+static inline xs *xs_new(xs *x, const void *p)
+{
+    return xs_new_len(x, p, strlen((const char *)p));
+}
+
+/* Refer to len bytes of storage that outlives x, NUL-terminated at len,
+ * without copying it. Nothing is allocated or reference counted, xs_free
+ * leaves the storage alone and the first write copies it out. Strings that
+ * fit are copied inline instead, which is as cheap and keeps them local.
+ */
+static inline xs *xs_new_static(xs *x, const char *p, size_t len)
+{
+    *x = xs_literal_empty();
+    if (len <= SHORT_STRING_LEN)
+    {
+        memcpy(x->data, p, len);
+        x->space_left = SHORT_STRING_LEN - len;
+        return x;
     }
+
+    x->ptr = (char *)p;
+    x->size = len;
+    x->is_ptr = true;
+    x->flag2 = 1;
     return x;
 }
 
-/* Memory leaks happen if the string is too long but it is still useful for
- * short strings.
+/* s must be a string literal, its length is known at compile time.
+ * xs_new_literal builds x in place, prefer it over copying out xs_literal.
  */
+#define xs_new_literal(x, s) xs_new_static(x, "" s, sizeof(s) - 1)
+#define xs_literal(s) xs_new_literal(&xs_literal_empty(), s)
+
 #define xs_tmp(x)                                                   \
     ((void)((struct {                                               \
          _Static_assert(sizeof(x) <= MAX_STR_LEN, "it is too big"); \
          int dummy;                                                 \
      }){1}),                                                        \
-     xs_new(&xs_literal_empty(), x))
+     xs_literal(x))
+
+static bool xs_cow_lazy_copy(xs *x, char **data);
 
-/* grow up to specified size */
-xs *xs_grow(xs *x, size_t len)
+/* grow up to specified size, NULL if that cannot be allocated, x is then
+ * left as it was
+ */
+static inline xs *xs_grow(xs *x, size_t len)
 {
     char buf[SHORT_STRING_LEN + 1];
+    size_t size = xs_size(x);
 
     if (len <= xs_capacity(x))
         return x;
@@ -181,21 +639,45 @@ xs *xs_grow(xs *x, size_t len)
     if (!xs_is_ptr(x))
         memcpy(buf, x->data, SHORT_STRING_LEN + 1);
 
+    /* the other owners still use the current buffer */
+    char *data = xs_data(x);
+    xs_cow_lazy_copy(x, &data);
+
+    size_t old_size = xs_is_ptr(x) ? xs_buffer_size(x) : 0;
+    size_t capacity = x->capacity;
     x->capacity = ilog2(len) + 1;
 
     if (xs_is_ptr(x))
     {
-        xs_allocate_data(x, len, 1);
+        if (!xs_allocate_data(x, len, old_size))
+        {
+            x->capacity = capacity;
+            return NULL;
+        }
     }
     else
     {
         x->is_ptr = true;
-        xs_allocate_data(x, len, 0);
+        x->size = size;
+        if (!xs_allocate_data(x, len, 0))
+        {
+            memcpy(x->data, buf, SHORT_STRING_LEN + 1);
+            return NULL;
+        }
         memcpy(xs_data(x), buf, SHORT_STRING_LEN + 1);
     }
     return x;
 }
 
+/* The page in front of a file mapping holds the length of the whole region
+ * at its start and the refcount header at its end.
+ */
+static inline void xs_unmap_file(const xs *x)
+{
+    char *base = x->ptr + XS_HEADER_SIZE - sysconf(_SC_PAGESIZE);
+    munmap(base, *(size_t *)base);
+}
+
 static inline xs *xs_newempty(xs *x)
 {
     *x = xs_literal_empty();
@@ -204,45 +686,97 @@ static inline xs *xs_newempty(xs *x)
 
 static inline xs *xs_free(xs *x)
 {
-    if (xs_is_ptr(x) && xs_dec_refcnt(x) <= 0)
-        free(x->ptr);
+    /* arena buffers are left to xs_scope_end */
+    if (xs_is_ptr(x) && !xs_is_static(x) && xs_dec_refcnt(x) <= 0 &&
+        !xs_is_arena(x))
+    {
+        if (xs_is_mapped(x))
+            xs_unmap_file(x);
+        else if (xs_is_huge(x))
+            munmap(x->ptr, xs_buffer_size(x));
+        else
+            xs_allocator_hook->free(x->ptr, xs_buffer_size(x));
+    }
     return xs_newempty(x);
 }
 
 static bool xs_cow_lazy_copy(xs *x, char **data)
 {
-    if (xs_get_refcnt(x) <= 1)
+    /* slices and static strings are read-only even without other owners */
+    bool borrowed = xs_is_slice(x) || xs_is_static(x);
+    if (!borrowed && xs_get_refcnt(x) <= 1)
         return false;
 
-    /* Lazy copy */
-    xs_dec_refcnt(x);
+    /* Lazy copy. Hold on to our reference until the data is copied out,
+     * another owner may drop the last one meanwhile.
+     */
+    xs old = *x;
+    if (borrowed)
+        x->capacity = ilog2(x->size + 1) + 1;
     xs_allocate_data(x, x->size, 0);
 
     if (data)
     {
         memcpy(xs_data(x), *data, x->size);
+        xs_data(x)[x->size] = 0;
 
         /* Update the newly allocated pointer */
         *data = xs_data(x);
     }
+    xs_free(&old);
     return true;
 }
 
-xs *xs_concat(xs *string, const xs *prefix, const xs *suffix)
+/* Move an arena string to a buffer of its own, so that it outlives the
+ * scope it was created in. Other strings are left alone.
+ */
+static inline xs *xs_escape(xs *x)
 {
-    size_t pres = xs_size(prefix), sufs = xs_size(suffix),
-           size = xs_size(string), capacity = xs_capacity(string);
+    if (!xs_is_arena(x))
+        return x;
+
+    int depth = xs_arena.depth;
+    xs tmp;
+    xs_arena.depth = 0;
+    xs_new_len(&tmp, xs_data(x), xs_size(x));
+    xs_arena.depth = depth;
+    xs_free(x);
+    *x = tmp;
+    return x;
+}
 
-    char *pre = xs_data(prefix), *suf = xs_data(suffix),
-         *data = xs_data(string);
+static inline xs *xs_concat(xs *string, const xs *prefix, const xs *suffix)
+{
+    size_t pres = xs_size(prefix), sufs = xs_size(suffix),
+           size = xs_size(string);
 
+    /* The operands are read only after this: a slice holding the last
+     * reference to its buffer frees it here, string may be one of them.
+     */
+    char *data = xs_data(string);
     xs_cow_lazy_copy(string, &data);
+    size_t capacity = xs_capacity(string);
+
+    /* Grow in place unless the string is also an operand: realloc may extend
+     * the block and huge strings are remapped rather than copied.
+     */
+    if (size + pres + sufs > capacity && prefix != string && suffix != string)
+    {
+        xs_grow(string, size + pres + sufs);
+        data = xs_data(string);
+        capacity = xs_capacity(string);
+    }
 
     if (size + pres + sufs <= capacity)
     {
         memmove(data + pres, data, size);
+        /* an operand that is string has just moved along */
+        const char *pre = prefix == string ? data + pres : xs_data(prefix),
+                   *suf = suffix == string ? data + pres : xs_data(suffix);
+        /* slices are not NUL-terminated */
+        memcpy(data + pres + size, suf, sufs);
         memcpy(data, pre, pres);
-        memcpy(data + pres + size, suf, sufs + 1);
+        data[size + pres + sufs] = 0;
 
         if (xs_is_ptr(string))
             string->size = size + pres + sufs;
@@ -251,88 +785,1184 @@ xs *xs_concat(xs *string, const xs *prefix, const xs *suffix)
     }
     else
     {
+        const char *pre = prefix == string ? data : xs_data(prefix),
+                   *suf = suffix == string ? data : xs_data(suffix);
         xs tmps = xs_literal_empty();
         xs_grow(&tmps, size + pres + sufs);
         char *tmpdata = xs_data(&tmps);
         memcpy(tmpdata + pres, data, size);
         memcpy(tmpdata, pre, pres);
-        memcpy(tmpdata + pres + size, suf, sufs + 1);
+        memcpy(tmpdata + pres + size, suf, sufs);
+        tmpdata[size + pres + sufs] = 0;
         xs_free(string);
         *string = tmps;
         string->size = size + pres + sufs;
     }
+    xs_invalidate_caches(string);
     return string;
 }
 
-xs *xs_trim(xs *x, const char *trimset)
+/* Append n pieces in one pass: the total size is known up front, so the
+ * string grows at most once and every piece is copied exactly once. The
+ * string itself may appear among the pieces.
+ */
+static inline xs *xs_append_n(xs *string, const xs *pieces, size_t n)
 {
-    if (!trimset[0])
-        return x;
+    size_t size = xs_size(string), total = size;
+    for (size_t i = 0; i < n; i++)
+        total += xs_size(&pieces[i]);
 
-    char *dataptr = xs_data(x), *orig = dataptr;
-
-    if (xs_cow_lazy_copy(x, &dataptr))
-        orig = dataptr;
+    char *data = xs_data(string);
+    xs_cow_lazy_copy(string, &data);
+    xs_grow(string, total);
+    data = xs_data(string);
 
-    /* similar to strspn/strpbrk but it operates on binary data */
-    uint8_t mask[32] = {0};
+    for (size_t i = 0, pos = size; i < n; i++)
+    {
+        const xs *p = &pieces[i];
+        size_t len = p == string ? size : xs_size(p);
+        memcpy(data + pos, p == string ? data : xs_data(p), len);
+        pos += len;
+    }
+    data[total] = 0;
 
-#define check_bit(byte) (mask[(uint8_t)byte / 8] & 1 << (uint8_t)byte % 8) // CCC
-#define set_bit(byte) (mask[(uint8_t)byte / 8] |= 1 << (uint8_t)byte % 8)  // SSS
-    size_t i, slen = xs_size(x), trimlen = strlen(trimset);
+    if (xs_is_ptr(string))
+        string->size = total;
+    else
+        string->space_left = SHORT_STRING_LEN - total;
+    xs_invalidate_caches(string);
+    return string;
+}
 
-    for (i = 0; i < trimlen; i++)
-        set_bit(trimset[i]);
-    for (i = 0; i < slen; i++)
-        if (!check_bit(dataptr[i]))
-            break;
-    for (; slen > 0; slen--)
-        if (!check_bit(dataptr[slen - 1]))
-            break;
-    dataptr += i;
-    slen -= i;
+/* A set of bytes, as taken by xs_trim and xs_find_any. SSE2 compares every
+ * byte against each member, so it only pays off for small sets. AVX2 looks
+ * the bytes up in the 256-bit mask instead.
+ */
+#define XS_SET_SSE2_MAX 8
 
-    /* reserved space as a buffer on the heap.
-     * Do not reallocate immediately. Instead, reuse it as possible.
-     * Do not shrink to in place if < 16 bytes.
+typedef struct
+{
+    uint8_t mask[32];
+#ifdef XS_HAVE_X86
+    /* mask rows indexed by the low nibble, a bit per high nibble:
+     * rows[0] holds high nibbles 0-7, rows[1] holds 8-15
      */
-    memmove(orig, dataptr, slen);
-    /* do not dirty memory unless it is needed */
-    if (orig[slen])
-        orig[slen] = 0;
+    uint8_t rows[2][16];
+    uint8_t members[XS_SET_SSE2_MAX];
+    int n;
+#endif
+} xs_byteset;
 
-    if (xs_is_ptr(x))
-        x->size = slen;
-    else
-        x->space_left = SHORT_STRING_LEN - slen;
-    return x;
-#undef check_bit
-#undef set_bit
-}
+#define xs_byteset_has(set, byte) \
+    ((set)->mask[(uint8_t)(byte) / 8] & 1 << (uint8_t)(byte) % 8)
 
-xs *xs_copy(xs *x)
+static inline void xs_byteset_init(xs_byteset *set, const char *bytes)
 {
-    xs *tmp = &xs_literal_empty();
-    if (!xs_is_ptr(x))
+    memset(set, 0, sizeof(*set));
+    for (; *bytes; bytes++)
     {
-        memcpy(xs_data(tmp), x, SHORT_STRING_LEN + 1);
+        uint8_t c = *bytes;
+        if (xs_byteset_has(set, c))
+            continue;
+        set->mask[c / 8] |= 1 << c % 8;
+#ifdef XS_HAVE_X86
+        if (set->n < XS_SET_SSE2_MAX)
+            set->members[set->n] = c;
+        set->n++;
+        set->rows[c >> 7][c & 0xF] |= 1 << (c >> 4 & 7);
+#endif
     }
-    else
+}
+
+#ifdef XS_HAVE_X86
+/* bit i of the result is set when byte i of v is in the set */
+__attribute__((target("sse2"))) static inline uint32_t xs_sse2_in_set(
+    __m128i v, const __m128i *members, int n)
+{
+    __m128i in = _mm_cmpeq_epi8(v, members[0]);
+    for (int k = 1; k < n; k++)
+        in = _mm_or_si128(in, _mm_cmpeq_epi8(v, members[k]));
+    return _mm_movemask_epi8(in);
+}
+
+/* Each byte is split into nibbles: the low nibble selects a row of the mask
+ * through vpshufb and the high nibble selects the bit inside that row.
+ */
+__attribute__((target("avx2"))) static inline uint32_t xs_avx2_in_set(
+    __m256i v, __m256i rows_lo, __m256i rows_hi)
+{
+    const __m256i bits = _mm256_setr_epi8(
+        1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8,
+        16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    const __m256i nib = _mm256_set1_epi8(0x0F);
+
+    __m256i lo = _mm256_and_si256(v, nib);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nib);
+    __m256i row = _mm256_blendv_epi8(_mm256_shuffle_epi8(rows_lo, lo),
+                                     _mm256_shuffle_epi8(rows_hi, lo),
+                                     _mm256_slli_epi16(hi, 4));
+    __m256i bit = _mm256_shuffle_epi8(bits, hi);
+    return _mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(_mm256_and_si256(row, bit), bit));
+}
+
+#define xs_avx2_rows(set, i)         \
+    _mm256_broadcastsi128_si256(     \
+        _mm_loadu_si128((const __m128i *)(set)->rows[i]))
+
+/* Scan [0, len) from both ends 16 bytes at a time. Returns the number of
+ * leading bytes in the set and stores the end of the kept range in *end.
+ */
+__attribute__((target("sse2"))) static size_t xs_trim_sse2(
+    const uint8_t *s, size_t len, const xs_byteset *set, size_t *end)
+{
+    size_t i = 0, j = len;
+    __m128i members[XS_SET_SSE2_MAX];
+    for (int k = 0; k < set->n; k++)
+        members[k] = _mm_set1_epi8((char)set->members[k]);
+
+#define in_set(p) \
+    xs_sse2_in_set(_mm_loadu_si128((const __m128i *)(p)), members, set->n)
+    for (; i + 16 <= len; i += 16)
     {
-        tmp->capacity = x->capacity;
-        tmp->is_ptr = true;
-        tmp->size = x->size;
-        if (xs_is_large_string(x))
+        uint32_t m = ~in_set(s + i) & 0xFFFF;
+        if (m)
         {
-            xs_inc_refcnt(x);
-            tmp->is_large_string = true;
-            tmp->ptr = x->ptr;
+            i += __builtin_ctz(m);
+            goto back;
         }
-        else
+    }
+    /* the tail is left to the scalar loop */
+    *end = len;
+    return i;
+
+back:
+    while (j - i >= 16)
+    {
+        uint32_t m = ~in_set(s + j - 16) & 0xFFFF;
+        if (m)
+        {
+            *end = j - 16 + 32 - __builtin_clz(m);
+            return i;
+        }
+        j -= 16;
+    }
+    *end = j;
+    return i;
+#undef in_set
+}
+
+/* Same as above with 32-byte blocks */
+__attribute__((target("avx2"))) static size_t xs_trim_avx2(
+    const uint8_t *s, size_t len, const xs_byteset *set, size_t *end)
+{
+    size_t i = 0, j = len;
+    const __m256i rows_lo = xs_avx2_rows(set, 0),
+                  rows_hi = xs_avx2_rows(set, 1);
+
+#define in_set(p)                                                     \
+    xs_avx2_in_set(_mm256_loadu_si256((const __m256i *)(p)), rows_lo, \
+                   rows_hi)
+    for (; i + 32 <= len; i += 32)
+    {
+        uint32_t m = ~in_set(s + i);
+        if (m)
+        {
+            i += __builtin_ctz(m);
+            goto back;
+        }
+    }
+    *end = len;
+    return i;
+
+back:
+    while (j - i >= 32)
+    {
+        uint32_t m = ~in_set(s + j - 32);
+        if (m)
+        {
+            *end = j - 32 + 32 - __builtin_clz(m);
+            return i;
+        }
+        j -= 32;
+    }
+    *end = j;
+    return i;
+#undef in_set
+}
+#endif
+
+static inline xs *xs_trim(xs *x, const char *trimset)
+{
+    if (!trimset[0])
+        return x;
+
+    char *dataptr = xs_data(x), *orig = dataptr;
+
+    if (xs_cow_lazy_copy(x, &dataptr))
+        orig = dataptr;
+
+    /* similar to strspn/strpbrk but it operates on binary data */
+    xs_byteset set;
+    xs_byteset_init(&set, trimset);
+
+#define check_bit(byte) xs_byteset_has(&set, byte) // CCC
+    size_t i, slen = xs_size(x), start = 0;
+
+#ifdef XS_HAVE_X86
+    /* short strings fit in a single vector, not worth the setup */
+    if (xs_is_ptr(x))
+    {
+        switch (xs_simd_level())
+        {
+        case XS_SIMD_AVX2:
+            start = xs_trim_avx2((const uint8_t *)dataptr, slen, &set, &slen);
+            break;
+        case XS_SIMD_SSE2:
+            if (set.n <= XS_SET_SSE2_MAX)
+                start =
+                    xs_trim_sse2((const uint8_t *)dataptr, slen, &set, &slen);
+            break;
+        }
+    }
+#endif
+
+    /* finish whatever the vector loops left, or do all of it */
+    for (i = start; i < slen; i++)
+        if (!check_bit(dataptr[i]))
+            break;
+    for (; slen > i; slen--)
+        if (!check_bit(dataptr[slen - 1]))
+            break;
+    dataptr += i;
+    slen -= i;
+
+    /* reserved space as a buffer on the heap.
+     * Do not reallocate immediately. Instead, reuse it as possible.
+     * Do not shrink to in place if < 16 bytes.
+     */
+    memmove(orig, dataptr, slen);
+    /* do not dirty memory unless it is needed */
+    if (orig[slen])
+        orig[slen] = 0;
+
+    if (xs_is_ptr(x))
+        x->size = slen;
+    else
+        x->space_left = SHORT_STRING_LEN - slen;
+    xs_invalidate_caches(x);
+    return x;
+#undef check_bit
+}
+
+/* returned by the search functions when there is no match */
+#define XS_NPOS ((size_t)-1)
+
+/* Needles up to this length go through the first/last byte filter, longer
+ * ones through glibc memmem, which is a two-way matcher for them.
+ */
+#define XS_FIND_SIMD_MAX 64
+
+/* last start of needle in h[0, n), scanning candidates from the end */
+static size_t xs_rfind_scalar(const char *h, size_t n, const char *needle,
+                              size_t k)
+{
+    size_t end = n - k + 1;
+    while (end)
+    {
+        const char *p = (const char *)memrchr(h, needle[0], end);
+        if (!p)
+            break;
+        if (!memcmp(p, needle, k))
+            return p - h;
+        end = p - h;
+    }
+    return XS_NPOS;
+}
+
+#ifdef XS_HAVE_X86
+/* Compare 16 candidate positions at once against the first and the last
+ * byte of the needle, only the positions matching both are memcmp-ed.
+ * Needles are 2 to XS_FIND_SIMD_MAX bytes long and k <= n.
+ */
+__attribute__((target("sse2"))) static size_t xs_find_sse2(const char *h,
+                                                           size_t n,
+                                                           const char *needle,
+                                                           size_t k)
+{
+    const __m128i first = _mm_set1_epi8(needle[0]),
+                  last = _mm_set1_epi8(needle[k - 1]);
+    size_t i = 0;
+
+    for (; i + k - 1 + 16 <= n; i += 16)
+    {
+        __m128i f = _mm_loadu_si128((const __m128i *)(h + i));
+        __m128i l = _mm_loadu_si128((const __m128i *)(h + i + k - 1));
+        uint32_t m = _mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(f, first), _mm_cmpeq_epi8(l, last)));
+        for (; m; m &= m - 1)
+        {
+            size_t pos = i + __builtin_ctz(m);
+            if (!memcmp(h + pos + 1, needle + 1, k - 2))
+                return pos;
+        }
+    }
+
+    const char *p = (const char *)memmem(h + i, n - i, needle, k);
+    return p ? (size_t)(p - h) : XS_NPOS;
+}
+
+__attribute__((target("sse2"))) static size_t xs_rfind_sse2(
+    const char *h, size_t n, const char *needle, size_t k)
+{
+    const __m128i first = _mm_set1_epi8(needle[0]),
+                  last = _mm_set1_epi8(needle[k - 1]);
+    size_t i = n - k + 1;
+
+    while (i >= 16)
+    {
+        i -= 16;
+        __m128i f = _mm_loadu_si128((const __m128i *)(h + i));
+        __m128i l = _mm_loadu_si128((const __m128i *)(h + i + k - 1));
+        uint32_t m = _mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(f, first), _mm_cmpeq_epi8(l, last)));
+        for (; m; m &= ~(1U << (31 - __builtin_clz(m))))
         {
+            size_t pos = i + 31 - __builtin_clz(m);
+            if (!memcmp(h + pos + 1, needle + 1, k - 2))
+                return pos;
+        }
+    }
+    return i ? xs_rfind_scalar(h, i + k - 1, needle, k) : XS_NPOS;
+}
+
+__attribute__((target("avx2"))) static size_t xs_find_avx2(const char *h,
+                                                           size_t n,
+                                                           const char *needle,
+                                                           size_t k)
+{
+    const __m256i first = _mm256_set1_epi8(needle[0]),
+                  last = _mm256_set1_epi8(needle[k - 1]);
+    size_t i = 0;
+
+#define candidates(p)                                                        \
+    _mm256_and_si256(                                                        \
+        _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p)), first),  \
+        _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)((p) + k - 1)), \
+                          last))
+    /* two blocks per iteration, matches are rare on real data */
+    for (; i + k - 1 + 64 <= n; i += 64)
+    {
+        __m256i c0 = candidates(h + i), c1 = candidates(h + i + 32);
+        if (_mm256_testz_si256(_mm256_or_si256(c0, c1),
+                               _mm256_or_si256(c0, c1)))
+            continue;
+        uint64_t m = (uint32_t)_mm256_movemask_epi8(c0) |
+                     (uint64_t)(uint32_t)_mm256_movemask_epi8(c1) << 32;
+        for (; m; m &= m - 1)
+        {
+            size_t pos = i + __builtin_ctzll(m);
+            if (!memcmp(h + pos + 1, needle + 1, k - 2))
+                return pos;
+        }
+    }
+    for (; i + k - 1 + 32 <= n; i += 32)
+    {
+        uint32_t m = _mm256_movemask_epi8(candidates(h + i));
+        for (; m; m &= m - 1)
+        {
+            size_t pos = i + __builtin_ctz(m);
+            if (!memcmp(h + pos + 1, needle + 1, k - 2))
+                return pos;
+        }
+    }
+#undef candidates
+
+    const char *p = (const char *)memmem(h + i, n - i, needle, k);
+    return p ? (size_t)(p - h) : XS_NPOS;
+}
+
+__attribute__((target("avx2"))) static size_t xs_rfind_avx2(
+    const char *h, size_t n, const char *needle, size_t k)
+{
+    const __m256i first = _mm256_set1_epi8(needle[0]),
+                  last = _mm256_set1_epi8(needle[k - 1]);
+    size_t i = n - k + 1;
+
+    while (i >= 32)
+    {
+        i -= 32;
+        __m256i f = _mm256_loadu_si256((const __m256i *)(h + i));
+        __m256i l = _mm256_loadu_si256((const __m256i *)(h + i + k - 1));
+        uint32_t m = _mm256_movemask_epi8(_mm256_and_si256(
+            _mm256_cmpeq_epi8(f, first), _mm256_cmpeq_epi8(l, last)));
+        for (; m; m &= ~(1U << (31 - __builtin_clz(m))))
+        {
+            size_t pos = i + 31 - __builtin_clz(m);
+            if (!memcmp(h + pos + 1, needle + 1, k - 2))
+                return pos;
+        }
+    }
+    return i ? xs_rfind_scalar(h, i + k - 1, needle, k) : XS_NPOS;
+}
+
+__attribute__((target("sse2"))) static size_t xs_find_any_sse2(
+    const uint8_t *s, size_t len, const xs_byteset *set)
+{
+    __m128i members[XS_SET_SSE2_MAX];
+    size_t i = 0;
+    for (int k = 0; k < set->n; k++)
+        members[k] = _mm_set1_epi8((char)set->members[k]);
+
+    for (; i + 16 <= len; i += 16)
+    {
+        uint32_t m = xs_sse2_in_set(_mm_loadu_si128((const __m128i *)(s + i)),
+                                    members, set->n);
+        if (m)
+            return i + __builtin_ctz(m);
+    }
+    return i;
+}
+
+__attribute__((target("avx2"))) static size_t xs_find_any_avx2(
+    const uint8_t *s, size_t len, const xs_byteset *set)
+{
+    const __m256i rows_lo = xs_avx2_rows(set, 0),
+                  rows_hi = xs_avx2_rows(set, 1);
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32)
+    {
+        uint32_t m = xs_avx2_in_set(
+            _mm256_loadu_si256((const __m256i *)(s + i)), rows_lo, rows_hi);
+        if (m)
+            return i + __builtin_ctz(m);
+    }
+    return i;
+}
+#endif
+
+/* Position of the first occurrence of needle in x at or after pos, or
+ * XS_NPOS. Both are searched by their size, so NUL bytes are matched too.
+ */
+static inline size_t xs_find(const xs *x, const xs *needle, size_t pos)
+{
+    const char *h = xs_data(x), *nd = xs_data(needle);
+    size_t n = xs_size(x), k = xs_size(needle);
+
+    if (pos > n || k > n - pos)
+        return XS_NPOS;
+    if (!k)
+        return pos;
+    h += pos;
+    n -= pos;
+
+    if (k == 1)
+    {
+        const char *p = (const char *)memchr(h, nd[0], n);
+        return p ? (size_t)(p - h) + pos : XS_NPOS;
+    }
+
+    size_t r;
+#ifdef XS_HAVE_X86
+    int level = k <= XS_FIND_SIMD_MAX ? xs_simd_level() : XS_SIMD_NONE;
+    if (level == XS_SIMD_AVX2)
+        r = xs_find_avx2(h, n, nd, k);
+    else if (level == XS_SIMD_SSE2)
+        r = xs_find_sse2(h, n, nd, k);
+    else
+#endif
+    {
+        const char *p = (const char *)memmem(h, n, nd, k);
+        r = p ? (size_t)(p - h) : XS_NPOS;
+    }
+    return r == XS_NPOS ? r : r + pos;
+}
+
+/* Position of the last occurrence of needle in x starting at or before pos,
+ * XS_NPOS searches the whole string.
+ */
+static inline size_t xs_rfind(const xs *x, const xs *needle, size_t pos)
+{
+    const char *h = xs_data(x), *nd = xs_data(needle);
+    size_t n = xs_size(x), k = xs_size(needle);
+
+    if (k > n)
+        return XS_NPOS;
+    if (pos > n - k)
+        pos = n - k;
+    if (!k)
+        return pos;
+    /* only candidates up to pos */
+    n = pos + k;
+
+#ifdef XS_HAVE_X86
+    if (k > 1 && k <= XS_FIND_SIMD_MAX)
+    {
+        switch (xs_simd_level())
+        {
+        case XS_SIMD_AVX2:
+            return xs_rfind_avx2(h, n, nd, k);
+        case XS_SIMD_SSE2:
+            return xs_rfind_sse2(h, n, nd, k);
+        }
+    }
+#endif
+    return xs_rfind_scalar(h, n, nd, k);
+}
+
+/* Position of the first byte of x at or after pos that is one of bytes, or
+ * XS_NPOS
+ */
+static inline size_t xs_find_any(const xs *x, const char *bytes, size_t pos)
+{
+    const uint8_t *s = (const uint8_t *)xs_data(x);
+    size_t n = xs_size(x);
+    xs_byteset set;
+
+    if (pos >= n || !bytes[0])
+        return XS_NPOS;
+    if (!bytes[1])
+    {
+        const uint8_t *p = (const uint8_t *)memchr(s + pos, bytes[0], n - pos);
+        return p ? (size_t)(p - s) : XS_NPOS;
+    }
+
+    xs_byteset_init(&set, bytes);
+#ifdef XS_HAVE_X86
+    switch (xs_simd_level())
+    {
+    case XS_SIMD_AVX2:
+        pos += xs_find_any_avx2(s + pos, n - pos, &set);
+        break;
+    case XS_SIMD_SSE2:
+        if (set.n <= XS_SET_SSE2_MAX)
+            pos += xs_find_any_sse2(s + pos, n - pos, &set);
+        break;
+    }
+#endif
+    for (; pos < n; pos++)
+        if (xs_byteset_has(&set, s[pos]))
+            return pos;
+    return XS_NPOS;
+}
+
+static inline xs *xs_copy_to(xs *tmp, const xs *x)
+{
+    *tmp = xs_literal_empty();
+    if (!xs_is_ptr(x))
+    {
+        memcpy(xs_data(tmp), x, SHORT_STRING_LEN + 1);
+    }
+    else
+    {
+        if (xs_is_large_string(x) || xs_is_static(x))
+        {
+            /* slices stay slices, static strings need no reference */
+            xs_inc_refcnt(x);
+            *tmp = *x;
+        }
+        else
+        {
+            tmp->capacity = x->capacity;
+            tmp->is_ptr = true;
+            tmp->size = x->size;
             xs_allocate_data(tmp, x->size, 0);
-            memcpy(xs_data(tmp), xs_data(x), x->size);
+            memcpy(xs_data(tmp), xs_data(x), x->size + 1);
         }
     }
     return tmp;
-}
\ No newline at end of file
+}
+
+/* The copy lives in the caller's scope, the same way as xs_tmp */
+#define xs_copy(x) xs_copy_to(&xs_literal_empty(), x)
+
+/* Make x refer to len bytes of src starting at pos, without copying when src
+ * is a large string: the slice shares its buffer and refcount and is copied
+ * out on the first write. Pieces that fit in the short string are copied
+ * inline instead. Unlike other strings, slices are not NUL-terminated.
+ */
+static inline xs *xs_slice(xs *x, const xs *src, size_t pos, size_t len)
+{
+    size_t size = xs_size(src);
+    if (pos > size)
+        pos = size;
+    if (len > size - pos)
+        len = size - pos;
+
+    if (len <= SHORT_STRING_LEN || !xs_is_large_string(src) ||
+        !xs_is_ptr(src))
+        return xs_new_len(x, xs_data(src) + pos, len);
+
+#ifdef XS_32
+    xs_inc_refcnt(src);
+    *x = *src;
+    x->offset = xs_data(src) + pos - (src->ptr + XS_HEADER_SIZE);
+    x->is_slice = 1;
+    x->is_interned = 0;
+    x->size = len;
+    return x;
+#else
+    return xs_new_len(x, xs_data(src) + pos, len);
+#endif
+}
+
+/* Split x at every occurrence of delim, empty fields included. At most max
+ * fields are stored, the last one holding the rest of x. Returns the number
+ * of fields stored, each to be released with xs_free.
+ */
+static inline size_t xs_split(xs *fields, size_t max, const xs *x, char delim)
+{
+    const char *data = xs_data(x), *p = data, *end = data + xs_size(x);
+    size_t n = 0;
+
+    if (!max)
+        return 0;
+
+    while (n + 1 < max)
+    {
+        const char *q = (const char *)memchr(p, delim, end - p);
+        if (!q)
+            break;
+        xs_slice(&fields[n++], x, p - data, q - p);
+        p = q + 1;
+    }
+    xs_slice(&fields[n++], x, p - data, end - p);
+    return n;
+}
+
+/* strtok_r for xs: skips runs of delimiters and stores the next token of x
+ * in tok as a slice. *pos is the scan position, start it at 0. Returns false
+ * once no token is left.
+ */
+static inline bool xs_tok(xs *tok, const xs *x, const char *delims, size_t *pos)
+{
+    const uint8_t *data = (const uint8_t *)xs_data(x);
+    size_t i = *pos, start, size = xs_size(x);
+    uint8_t mask[32] = {0};
+
+#define check_bit(byte) (mask[(uint8_t)byte / 8] & 1 << (uint8_t)byte % 8)
+#define set_bit(byte) (mask[(uint8_t)byte / 8] |= 1 << (uint8_t)byte % 8)
+    for (; *delims; delims++)
+        set_bit(*delims);
+
+    while (i < size && check_bit(data[i]))
+        i++;
+    start = i;
+    while (i < size && !check_bit(data[i]))
+        i++;
+#undef check_bit
+#undef set_bit
+
+    *pos = i;
+    if (start == i)
+        return false;
+    xs_slice(tok, x, start, i - start);
+    return true;
+}
+
+/* Files from this size on are mapped rather than read */
+#define XS_MAP_FILE_MIN (64 << 10)
+
+/* Load a whole file into x. Large files become a read-only MAP_PRIVATE
+ * mapping shared through the usual refcount: no data is copied until the
+ * first write, which copies it out like for a slice. The mapping is released
+ * with the last reference. Returns NULL if the file can not be read.
+ */
+static inline xs *xs_from_file(xs *x, const char *path)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    xs_newempty(x);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) < 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+#ifdef XS_32
+    if ((size_t)st.st_size >= XS_MAP_FILE_MIN)
+    {
+        size_t page = sysconf(_SC_PAGESIZE), size = st.st_size;
+        /* at least one zero byte follows the data: a NUL terminator */
+        size_t len = page + (size + page) / page * page;
+        char *base = (char *)mmap(NULL, len, PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED ||
+            mmap(base + page, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd,
+                 0) == MAP_FAILED)
+        {
+            if (base != MAP_FAILED)
+                munmap(base, len);
+            close(fd);
+            return NULL;
+        }
+        close(fd);
+
+        *(size_t *)base = len;
+        x->ptr = base + page - XS_HEADER_SIZE;
+        x->is_ptr = true;
+        x->is_large_string = true;
+        x->is_slice = true;
+        x->is_mapped = true;
+        x->size = size;
+        x->capacity = ilog2(size) + 1;
+        xs_set_refcnt(x, 1);
+        xs_set_hash_cache(x, 0);
+        return x;
+    }
+#endif
+
+    size_t size = st.st_size, n = 0;
+    xs_grow(x, size);
+    char *data = xs_data(x);
+    while (n < size)
+    {
+        ssize_t r = read(fd, data + n, size - n);
+        if (r <= 0)
+            break;
+        n += r;
+    }
+    close(fd);
+    if (n < size)
+    {
+        xs_free(x);
+        return NULL;
+    }
+
+    data[size] = 0;
+    if (xs_is_ptr(x))
+        x->size = size;
+    else
+        x->space_left = SHORT_STRING_LEN - size;
+    return x;
+}
+
+static inline uint64_t xs_mum(uint64_t a, uint64_t b)
+{
+    __uint128_t r = (__uint128_t)a * b;
+    return (uint64_t)r ^ (uint64_t)(r >> 64);
+}
+
+static inline uint64_t xs_load64(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/* Multiply-mix hash over 16-byte blocks in the style of wyhash. Never 0, so
+ * that 0 can mark an empty cache or slot.
+ */
+static uint32_t xs_hash_bytes(const void *p, size_t len)
+{
+    const uint64_t k0 = 0xa0761d6478bd642full, k1 = 0xe7037ed1a0b428dbull,
+                   k2 = 0x8ebc6af09c88c6e3ull;
+    const uint8_t *s = (const uint8_t *)p;
+    uint64_t h = len ^ k0, tail = 0;
+    size_t n = len;
+
+    for (; n >= 16; s += 16, n -= 16)
+        h = xs_mum(xs_load64(s) ^ k1, xs_load64(s + 8) ^ h);
+    if (n >= 8)
+    {
+        h = xs_mum(xs_load64(s) ^ k1, h ^ k2);
+        s += 8;
+        n -= 8;
+    }
+    memcpy(&tail, s, n);
+    h = xs_mum(xs_mum(tail ^ k2, h ^ k1), len ^ k0);
+
+    uint32_t r = (uint32_t)(h ^ h >> 32);
+    return r == 0 ? 1 : r;
+}
+
+/* Hash of the content. Large strings compute it once and keep it in their
+ * header until they are modified through the xs functions; writing through
+ * xs_data() directly does not reset it.
+ */
+static inline uint32_t xs_hash(const xs *x)
+{
+    if (!xs_is_ptr(x) || !xs_is_large_string(x) || xs_is_slice(x))
+        return xs_hash_bytes(xs_data(x), xs_size(x));
+
+    uint32_t h = xs_get_hash_cache(x);
+    if (!h)
+    {
+        h = xs_hash_bytes(xs_data(x), xs_size(x));
+        xs_set_hash_cache(x, h);
+    }
+    return h;
+}
+
+static inline bool xs_equal(const xs *a, const xs *b)
+{
+    size_t size = xs_size(a);
+    if (size != xs_size(b))
+        return false;
+
+    /* Two short strings: compare the whole unions, then keep the bits of
+     * the bytes in use, what follows the terminator may be stale.
+     */
+    if (!xs_is_ptr(a) && !xs_is_ptr(b))
+    {
+#ifdef __SSE2__
+        __m128i a0 = _mm_loadu_si128((const __m128i *)a->data),
+                a1 = _mm_loadu_si128((const __m128i *)(a->data + 16)),
+                b0 = _mm_loadu_si128((const __m128i *)b->data),
+                b1 = _mm_loadu_si128((const __m128i *)(b->data + 16));
+        uint32_t eq = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(a0, b0)) |
+                      (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(a1, b1))
+                          << 16;
+        uint32_t used = ((uint32_t)1 << size) - 1;
+        return (eq & used) == used;
+#else
+        return !memcmp(a->data, b->data, size);
+#endif
+    }
+
+    const char *da = xs_data(a), *db = xs_data(b);
+    if (da == db)
+        return true;
+    /* one buffer per content, the intern set being one for the program */
+    if (xs_is_interned(a) && xs_is_interned(b))
+        return false;
+    if (xs_is_ptr(a) && xs_is_ptr(b) && xs_is_large_string(a) &&
+        xs_is_large_string(b) && !xs_is_slice(a) && !xs_is_slice(b))
+    {
+        uint32_t ha = xs_get_hash_cache(a), hb = xs_get_hash_cache(b);
+        if (ha && hb && ha != hb)
+            return false;
+    }
+    return !memcmp(da, db, size);
+}
+
+/* UTF-8 as of RFC 3629: no overlong forms, no surrogates, nothing above
+ * U+10FFFF.
+ */
+static bool xs_utf8_valid_scalar(const uint8_t *s, size_t n)
+{
+    size_t i = 0;
+    while (i < n)
+    {
+        uint8_t c = s[i];
+        if (c < 0x80)
+        {
+            i++;
+            continue;
+        }
+
+        size_t len;
+        uint8_t lo = 0x80, hi = 0xBF; /* range of the second byte */
+        if (c >= 0xC2 && c <= 0xDF)
+            len = 2;
+        else if (c >= 0xE0 && c <= 0xEF)
+        {
+            len = 3;
+            if (c == 0xE0)
+                lo = 0xA0;
+            else if (c == 0xED)
+                hi = 0x9F;
+        }
+        else if (c >= 0xF0 && c <= 0xF4)
+        {
+            len = 4;
+            if (c == 0xF0)
+                lo = 0x90;
+            else if (c == 0xF4)
+                hi = 0x8F;
+        }
+        else
+            return false;
+
+        if (n - i < len || s[i + 1] < lo || s[i + 1] > hi)
+            return false;
+        for (size_t j = 2; j < len; j++)
+            if ((s[i + j] & 0xC0) != 0x80)
+                return false;
+        i += len;
+    }
+    return true;
+}
+
+#ifdef XS_HAVE_X86
+/* Lookup validation by Keiser and Lemire, as in simdjson: three nibble
+ * tables classify each byte together with the one before it, every bit
+ * standing for a kind of error, so that an error is a bit set in all
+ * three. What they cannot see, a missing or extra third and fourth byte,
+ * is checked against the lead bytes two and three positions back.
+ */
+#define XS_UTF8_TOO_SHORT (1 << 0)
+#define XS_UTF8_TOO_LONG (1 << 1)
+#define XS_UTF8_OVERLONG_3 (1 << 2)
+#define XS_UTF8_TOO_LARGE (1 << 3)
+#define XS_UTF8_SURROGATE (1 << 4)
+#define XS_UTF8_OVERLONG_2 (1 << 5)
+#define XS_UTF8_TOO_LARGE_1000 (1 << 6)
+#define XS_UTF8_OVERLONG_4 (1 << 6)
+#define XS_UTF8_TWO_CONTS (1 << 7)
+#define XS_UTF8_CARRY \
+    (XS_UTF8_TOO_SHORT | XS_UTF8_TOO_LONG | XS_UTF8_TWO_CONTS)
+
+/* the 32 bytes ending n bytes before the end of cur */
+#define xs_avx2_prev(cur, prev, n) \
+    _mm256_alignr_epi8(cur, _mm256_permute2x128_si256(prev, cur, 0x21), 16 - n)
+
+__attribute__((target("avx2"))) static inline __m256i
+xs_utf8_block_avx2(__m256i cur, __m256i prev)
+{
+    const __m256i lo_nibble = _mm256_set1_epi8(0x0F);
+    const __m256i byte_1_high_table = _mm256_setr_epi8(
+        XS_UTF8_TOO_LONG, XS_UTF8_TOO_LONG, XS_UTF8_TOO_LONG, XS_UTF8_TOO_LONG,
+        XS_UTF8_TOO_LONG, XS_UTF8_TOO_LONG, XS_UTF8_TOO_LONG, XS_UTF8_TOO_LONG,
+        XS_UTF8_TWO_CONTS, XS_UTF8_TWO_CONTS, XS_UTF8_TWO_CONTS,
+        XS_UTF8_TWO_CONTS, XS_UTF8_TOO_SHORT | XS_UTF8_OVERLONG_2,
+        XS_UTF8_TOO_SHORT,
+        XS_UTF8_TOO_SHORT | XS_UTF8_OVERLONG_3 | XS_UTF8_SURROGATE,
+        XS_UTF8_TOO_SHORT | XS_UTF8_TOO_LARGE | XS_UTF8_TOO_LARGE_1000 |
+            XS_UTF8_OVERLONG_4,
+        XS_UTF8_TOO_LONG, XS_UTF8_TOO_LONG, XS_UTF8_TOO_LONG, XS_UTF8_TOO_LONG,
+        XS_UTF8_TOO_LONG, XS_UTF8_TOO_LONG, XS_UTF8_TOO_LONG, XS_UTF8_TOO_LONG,
+        XS_UTF8_TWO_CONTS, XS_UTF8_TWO_CONTS, XS_UTF8_TWO_CONTS,
+        XS_UTF8_TWO_CONTS, XS_UTF8_TOO_SHORT | XS_UTF8_OVERLONG_2,
+        XS_UTF8_TOO_SHORT,
+        XS_UTF8_TOO_SHORT | XS_UTF8_OVERLONG_3 | XS_UTF8_SURROGATE,
+        XS_UTF8_TOO_SHORT | XS_UTF8_TOO_LARGE | XS_UTF8_TOO_LARGE_1000 |
+            XS_UTF8_OVERLONG_4);
+#define XS_UTF8_LARGE (XS_UTF8_CARRY | XS_UTF8_TOO_LARGE | XS_UTF8_TOO_LARGE_1000)
+    const __m256i byte_1_low_table = _mm256_setr_epi8(
+        XS_UTF8_CARRY | XS_UTF8_OVERLONG_3 | XS_UTF8_OVERLONG_2 |
+            XS_UTF8_OVERLONG_4,
+        XS_UTF8_CARRY | XS_UTF8_OVERLONG_2, XS_UTF8_CARRY, XS_UTF8_CARRY,
+        XS_UTF8_CARRY | XS_UTF8_TOO_LARGE, XS_UTF8_LARGE, XS_UTF8_LARGE,
+        XS_UTF8_LARGE, XS_UTF8_LARGE, XS_UTF8_LARGE, XS_UTF8_LARGE,
+        XS_UTF8_LARGE, XS_UTF8_LARGE, XS_UTF8_LARGE | XS_UTF8_SURROGATE,
+        XS_UTF8_LARGE, XS_UTF8_LARGE,
+        XS_UTF8_CARRY | XS_UTF8_OVERLONG_3 | XS_UTF8_OVERLONG_2 |
+            XS_UTF8_OVERLONG_4,
+        XS_UTF8_CARRY | XS_UTF8_OVERLONG_2, XS_UTF8_CARRY, XS_UTF8_CARRY,
+        XS_UTF8_CARRY | XS_UTF8_TOO_LARGE, XS_UTF8_LARGE, XS_UTF8_LARGE,
+        XS_UTF8_LARGE, XS_UTF8_LARGE, XS_UTF8_LARGE, XS_UTF8_LARGE,
+        XS_UTF8_LARGE, XS_UTF8_LARGE, XS_UTF8_LARGE | XS_UTF8_SURROGATE,
+        XS_UTF8_LARGE, XS_UTF8_LARGE);
+#undef XS_UTF8_LARGE
+#define XS_UTF8_CONT (XS_UTF8_TOO_LONG | XS_UTF8_OVERLONG_2 | XS_UTF8_TWO_CONTS)
+    const __m256i byte_2_high_table = _mm256_setr_epi8(
+        XS_UTF8_TOO_SHORT, XS_UTF8_TOO_SHORT, XS_UTF8_TOO_SHORT,
+        XS_UTF8_TOO_SHORT, XS_UTF8_TOO_SHORT, XS_UTF8_TOO_SHORT,
+        XS_UTF8_TOO_SHORT, XS_UTF8_TOO_SHORT,
+        XS_UTF8_CONT | XS_UTF8_OVERLONG_3 | XS_UTF8_TOO_LARGE_1000 |
+            XS_UTF8_OVERLONG_4,
+        XS_UTF8_CONT | XS_UTF8_OVERLONG_3 | XS_UTF8_TOO_LARGE,
+        XS_UTF8_CONT | XS_UTF8_SURROGATE | XS_UTF8_TOO_LARGE,
+        XS_UTF8_CONT | XS_UTF8_SURROGATE | XS_UTF8_TOO_LARGE,
+        XS_UTF8_TOO_SHORT, XS_UTF8_TOO_SHORT, XS_UTF8_TOO_SHORT,
+        XS_UTF8_TOO_SHORT, XS_UTF8_TOO_SHORT, XS_UTF8_TOO_SHORT,
+        XS_UTF8_TOO_SHORT, XS_UTF8_TOO_SHORT, XS_UTF8_TOO_SHORT,
+        XS_UTF8_TOO_SHORT, XS_UTF8_TOO_SHORT, XS_UTF8_TOO_SHORT,
+        XS_UTF8_CONT | XS_UTF8_OVERLONG_3 | XS_UTF8_TOO_LARGE_1000 |
+            XS_UTF8_OVERLONG_4,
+        XS_UTF8_CONT | XS_UTF8_OVERLONG_3 | XS_UTF8_TOO_LARGE,
+        XS_UTF8_CONT | XS_UTF8_SURROGATE | XS_UTF8_TOO_LARGE,
+        XS_UTF8_CONT | XS_UTF8_SURROGATE | XS_UTF8_TOO_LARGE,
+        XS_UTF8_TOO_SHORT, XS_UTF8_TOO_SHORT, XS_UTF8_TOO_SHORT,
+        XS_UTF8_TOO_SHORT);
+#undef XS_UTF8_CONT
+
+    __m256i prev1 = xs_avx2_prev(cur, prev, 1);
+    __m256i special = _mm256_and_si256(
+        _mm256_and_si256(
+            _mm256_shuffle_epi8(
+                byte_1_high_table,
+                _mm256_and_si256(_mm256_srli_epi16(prev1, 4), lo_nibble)),
+            _mm256_shuffle_epi8(byte_1_low_table,
+                                _mm256_and_si256(prev1, lo_nibble))),
+        _mm256_shuffle_epi8(
+            byte_2_high_table,
+            _mm256_and_si256(_mm256_srli_epi16(cur, 4), lo_nibble)));
+
+    /* a third or fourth byte of a sequence must be a continuation */
+    __m256i third = _mm256_subs_epu8(xs_avx2_prev(cur, prev, 2),
+                                     _mm256_set1_epi8(0xE0 - 0x80)),
+            fourth = _mm256_subs_epu8(xs_avx2_prev(cur, prev, 3),
+                                      _mm256_set1_epi8(0xF0 - 0x80));
+    __m256i must23 = _mm256_and_si256(_mm256_or_si256(third, fourth),
+                                      _mm256_set1_epi8((char)0x80));
+    return _mm256_xor_si256(must23, special);
+}
+
+__attribute__((target("avx2"))) static bool
+xs_utf8_valid_avx2(const uint8_t *s, size_t n)
+{
+    /* leads that need more bytes than the block has left */
+    const __m256i max_tail = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0xF0 - 1, 0xE0 - 1,
+        0xC0 - 1);
+    __m256i prev = _mm256_setzero_si256(), error = _mm256_setzero_si256(),
+            incomplete = _mm256_setzero_si256();
+    uint8_t tail[32] = {0};
+    size_t i = 0;
+
+    for (;; i += 32)
+    {
+        __m256i cur;
+        if (i + 32 <= n)
+            cur = _mm256_loadu_si256((const __m256i *)(s + i));
+        else if (i < n)
+        {
+            /* the padding is ASCII, a sequence cut short fails on it */
+            memcpy(tail, s + i, n - i);
+            cur = _mm256_loadu_si256((const __m256i *)tail);
+        }
+        else
+            break;
+
+        if (_mm256_movemask_epi8(cur))
+        {
+            error = _mm256_or_si256(error, xs_utf8_block_avx2(cur, prev));
+            incomplete = _mm256_subs_epu8(cur, max_tail);
+        }
+        else
+        {
+            /* ASCII only, unless the block before ended mid-sequence */
+            error = _mm256_or_si256(error, incomplete);
+            incomplete = _mm256_setzero_si256();
+        }
+        prev = cur;
+
+        /* stop at the first bad block, not at the end of a long string */
+        if ((i & 1023) == 992 && !_mm256_testz_si256(error, error))
+            return false;
+    }
+    error = _mm256_or_si256(error, incomplete);
+    return _mm256_testz_si256(error, error);
+}
+
+/* SSE2 has no byte shuffle for the tables, it skips the ASCII runs */
+__attribute__((target("sse2"))) static bool
+xs_utf8_valid_sse2(const uint8_t *s, size_t n)
+{
+    size_t i = 0;
+    while (i + 16 <= n)
+    {
+        if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(s + i))))
+        {
+            /* back up to the lead of the sequence the block starts in */
+            while (i && (s[i] & 0xC0) == 0x80)
+                i--;
+            size_t end = i + 16;
+            while (end < n && (s[end] & 0xC0) == 0x80)
+                end++;
+            if (!xs_utf8_valid_scalar(s + i, end - i))
+                return false;
+            i = end;
+        }
+        else
+            i += 16;
+    }
+    while (i && i < n && (s[i] & 0xC0) == 0x80)
+        i--;
+    return xs_utf8_valid_scalar(s + i, n - i);
+}
+
+__attribute__((target("avx2"))) static size_t
+xs_utf8_length_avx2(const uint8_t *s, size_t n)
+{
+    size_t count = 0, i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+        /* continuation bytes are -128 to -65 signed, the rest are larger */
+        count += __builtin_popcount(_mm256_movemask_epi8(
+            _mm256_cmpgt_epi8(v, _mm256_set1_epi8(-65))));
+    }
+    for (; i < n; i++)
+        count += (int8_t)s[i] > -65;
+    return count;
+}
+
+__attribute__((target("sse2"))) static size_t
+xs_utf8_length_sse2(const uint8_t *s, size_t n)
+{
+    size_t count = 0, i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        count += __builtin_popcount(
+            _mm_movemask_epi8(_mm_cmpgt_epi8(v, _mm_set1_epi8(-65))));
+    }
+    for (; i < n; i++)
+        count += (int8_t)s[i] > -65;
+    return count;
+}
+#undef xs_avx2_prev
+#endif
+
+/* A short string found to be ASCII is marked with flag2, so that checking
+ * it again is free. Anything that changes it drops the mark. A string of
+ * SHORT_STRING_LEN bytes is never marked: its flags byte is also its
+ * terminator and has to stay 0.
+ */
+static inline bool xs_utf8_valid(xs *x)
+{
+    if (!xs_is_ptr(x) && x->flag2)
+        return true;
+
+    const uint8_t *s = (const uint8_t *)xs_data(x);
+    size_t n = xs_size(x);
+    if (!xs_is_ptr(x))
+    {
+        uint32_t high = 0;
+        for (size_t i = 0; i < n; i++)
+            high |= s[i];
+        if (high < 0x80)
+        {
+            /* a full short string has its terminator in the flags byte */
+            if (x->space_left)
+                x->flag2 = 1;
+            return true;
+        }
+        return xs_utf8_valid_scalar(s, n);
+    }
+
+#ifdef XS_HAVE_X86
+    switch (xs_simd_level())
+    {
+    case XS_SIMD_AVX2:
+        return xs_utf8_valid_avx2(s, n);
+    case XS_SIMD_SSE2:
+        return xs_utf8_valid_sse2(s, n);
+    }
+#endif
+    return xs_utf8_valid_scalar(s, n);
+}
+
+/* Number of code points, that is of bytes other than continuation bytes.
+ * An invalid sequence counts as many code points as it has lead bytes.
+ */
+static inline size_t xs_utf8_length(const xs *x)
+{
+    const uint8_t *s = (const uint8_t *)xs_data(x);
+    size_t n = xs_size(x);
+
+    if (!xs_is_ptr(x) && x->flag2)
+        return n;
+
+#ifdef XS_HAVE_X86
+    switch (xs_simd_level())
+    {
+    case XS_SIMD_AVX2:
+        return xs_utf8_length_avx2(s, n);
+    case XS_SIMD_SSE2:
+        return xs_utf8_length_sse2(s, n);
+    }
+#endif
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++)
+        count += (int8_t)s[i] > -65;
+    return count;
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include <functional>
+#include <string_view>
+#include <utility>
+
+#include "xs.h"
+
+/* Owning C++ handle on an xs, freed with xs_free when it goes out of scope.
+ *
+ * Moving hands the whole union over, heap pointer included, and leaves the
+ * source an empty short string, so it never allocates and never throws.
+ * Copying goes through xs_copy_to: short strings are copied inline, large
+ * ones share the buffer and bump its refcount, copy-on-write does the rest.
+ * The C API stays available through get().
+ */
+class xs_string
+{
+public:
+    xs_string() noexcept { xs_newempty(&s_); }
+
+    xs_string(const char *p) { xs_new(&s_, p); }
+
+    xs_string(std::string_view sv) { xs_new_len(&s_, sv.data(), sv.size()); }
+
+    /* Refers to len bytes at p, NUL-terminated at len, without copying
+     * them. They must stay unchanged for as long as the string or any copy
+     * of it lives, which takes static storage in practice: see
+     * xs_new_static, and xs_string_literal for string literals.
+     */
+    static xs_string from_static(const char *p, size_t len) noexcept
+    {
+        xs_string r;
+        xs_new_static(&r.s_, p, len);
+        return r;
+    }
+
+    xs_string(const xs_string &other) { xs_copy_to(&s_, &other.s_); }
+
+    xs_string(xs_string &&other) noexcept : s_(other.s_)
+    {
+        xs_newempty(&other.s_);
+    }
+
+    ~xs_string() { xs_free(&s_); }
+
+    xs_string &operator=(const xs_string &other)
+    {
+        if (this != &other)
+        {
+            xs_string tmp(other);
+            swap(tmp);
+        }
+        return *this;
+    }
+
+    xs_string &operator=(xs_string &&other) noexcept
+    {
+        if (this != &other)
+        {
+            xs_free(&s_);
+            s_ = other.s_;
+            xs_newempty(&other.s_);
+        }
+        return *this;
+    }
+
+    void swap(xs_string &other) noexcept { std::swap(s_, other.s_); }
+
+    /* slices are not NUL-terminated, hence no c_str() */
+    const char *data() const noexcept { return xs_data(&s_); }
+    size_t size() const noexcept { return xs_size(&s_); }
+    size_t capacity() const noexcept { return xs_capacity(&s_); }
+    bool empty() const noexcept { return size() == 0; }
+
+    operator std::string_view() const noexcept
+    {
+        return std::string_view(data(), size());
+    }
+
+    xs *get() noexcept { return &s_; }
+    const xs *get() const noexcept { return &s_; }
+
+    void clear() noexcept { xs_free(&s_); }
+
+    xs_string &reserve(size_t len)
+    {
+        xs_grow(&s_, len);
+        return *this;
+    }
+
+    xs_string &operator+=(const xs_string &suffix)
+    {
+        xs_append_n(&s_, &suffix.s_, 1);
+        return *this;
+    }
+
+    xs_string &concat(const xs_string &prefix, const xs_string &suffix)
+    {
+        xs_concat(&s_, &prefix.s_, &suffix.s_);
+        return *this;
+    }
+
+    xs_string &trim(const char *trimset)
+    {
+        xs_trim(&s_, trimset);
+        return *this;
+    }
+
+    size_t find(const xs_string &needle, size_t pos = 0) const
+    {
+        return xs_find(&s_, &needle.s_, pos);
+    }
+
+    /* the view shares the buffer of a large string */
+    xs_string substr(size_t pos, size_t len = XS_NPOS) const
+    {
+        xs_string r;
+        xs_slice(&r.s_, &s_, pos, len);
+        return r;
+    }
+
+    uint32_t hash() const { return xs_hash(&s_); }
+
+    friend bool operator==(const xs_string &a, const xs_string &b)
+    {
+        return xs_equal(&a.s_, &b.s_);
+    }
+
+    friend bool operator!=(const xs_string &a, const xs_string &b)
+    {
+        return !(a == b);
+    }
+
+private:
+    xs s_;
+};
+
+/* s must be a string literal, as for xs_literal */
+#define xs_string_literal(s) xs_string::from_static("" s, sizeof(s) - 1)
+
+namespace std
+{
+template <> struct hash<xs_string>
+{
+    size_t operator()(const xs_string &s) const { return s.hash(); }
+};
+} // namespace std
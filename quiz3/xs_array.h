@@ -0,0 +1,348 @@
+#pragma once
+#include <pthread.h>
+
+#include "xs.h"
+
+/* Growable array of xs that keeps the first 8 bytes of every string, big
+ * endian and zero padded, in a packed key array next to the items.
+ *
+ * xs_array_sort is an MSD radix sort on those keys: it reads 16-byte
+ * (key, index) pairs only and dereferences string data just to order
+ * strings sharing all 8 bytes. The order is the one of memcmp followed by
+ * length, that is strcmp for strings without NUL bytes.
+ */
+#define XS_ARRAY_MIN_CAPACITY 16
+#define XS_ARRAY_KEY_BYTES 8
+
+/* buckets smaller than this are left to insertion sort */
+#define XS_ARRAY_RADIX_MIN 32
+/* do not split sorts smaller than this across threads */
+#define XS_ARRAY_PARALLEL_MIN (1 << 14)
+#define XS_ARRAY_MAX_THREADS 64
+
+typedef struct
+{
+    xs *items;
+    uint64_t *keys;
+    size_t size, capacity;
+} xs_array;
+
+typedef struct
+{
+    uint64_t key;
+    size_t index;
+} xs_array_pair;
+
+static inline void xs_array_init(xs_array *a)
+{
+    a->items = NULL;
+    a->keys = NULL;
+    a->size = a->capacity = 0;
+}
+
+static inline void xs_array_free(xs_array *a)
+{
+    for (size_t i = 0; i < a->size; i++)
+        xs_free(&a->items[i]);
+    free(a->items);
+    free(a->keys);
+    xs_array_init(a);
+}
+
+static inline const xs *xs_array_at(const xs_array *a, size_t i)
+{
+    return &a->items[i];
+}
+
+static inline uint64_t xs_array_key(const xs *x)
+{
+    const uint8_t *p = (const uint8_t *)xs_data(x);
+    size_t len = xs_size(x);
+    uint64_t key = 0;
+
+    if (len >= XS_ARRAY_KEY_BYTES)
+        return __builtin_bswap64(xs_load64(p));
+    for (size_t i = 0; i < len; i++)
+        key |= (uint64_t)p[i] << (56 - 8 * i);
+    return key;
+}
+
+/* Append a copy of x, see xs_copy_to. Arena strings are copied out. */
+static inline bool xs_array_push(xs_array *a, const xs *x)
+{
+    if (a->size == a->capacity)
+    {
+        size_t capacity =
+            a->capacity ? a->capacity * 2 : XS_ARRAY_MIN_CAPACITY;
+        xs *items = (xs *)realloc(a->items, capacity * sizeof(xs));
+        if (!items)
+            return false;
+        a->items = items;
+        uint64_t *keys =
+            (uint64_t *)realloc(a->keys, capacity * sizeof(*keys));
+        if (!keys)
+            return false;
+        a->keys = keys;
+        a->capacity = capacity;
+    }
+    xs_escape(xs_copy_to(&a->items[a->size], x));
+    a->keys[a->size++] = xs_array_key(x);
+    return true;
+}
+
+/* Replace item i with a copy of x; the items must not be changed otherwise */
+static inline void xs_array_set(xs_array *a, size_t i, const xs *x)
+{
+    xs_free(&a->items[i]);
+    xs_escape(xs_copy_to(&a->items[i], x));
+    a->keys[i] = xs_array_key(x);
+}
+
+static inline int xs_array_cmp(const xs_array_pair *p, const xs_array_pair *q,
+                               const xs *items)
+{
+    if (p->key != q->key)
+        return p->key < q->key ? -1 : 1;
+
+    /* a tie: the first 8 bytes, or all of both strings, are equal */
+    const xs *a = &items[p->index], *b = &items[q->index];
+    size_t la = xs_size(a), lb = xs_size(b), n = la < lb ? la : lb;
+    if (n > XS_ARRAY_KEY_BYTES)
+    {
+        int r =
+            memcmp(xs_data(a) + XS_ARRAY_KEY_BYTES,
+                   xs_data(b) + XS_ARRAY_KEY_BYTES, n - XS_ARRAY_KEY_BYTES);
+        if (r)
+            return r;
+    }
+    return la < lb ? -1 : la > lb;
+}
+
+static void xs_array_insertion_sort(xs_array_pair *v, size_t n,
+                                    const xs *items)
+{
+    for (size_t i = 1; i < n; i++)
+    {
+        xs_array_pair t = v[i];
+        size_t j = i;
+        for (; j && xs_array_cmp(&t, &v[j - 1], items) < 0; j--)
+            v[j] = v[j - 1];
+        v[j] = t;
+    }
+}
+
+static int xs_array_qsort_cmp(const void *p, const void *q, void *items)
+{
+    return xs_array_cmp((const xs_array_pair *)p, (const xs_array_pair *)q,
+                        (const xs *)items);
+}
+
+#define xs_array_digit(key, byte) ((key) >> (56 - 8 * (byte)) & 0xFF)
+
+/* Sort v on key byte `byte` and the ones after it, tmp is scratch space */
+static void xs_array_msd(xs_array_pair *v, xs_array_pair *tmp, size_t n,
+                         int byte, const xs *items)
+{
+    if (n < XS_ARRAY_RADIX_MIN)
+    {
+        xs_array_insertion_sort(v, n, items);
+        return;
+    }
+
+    /* the keys are equal, only the string data can order them */
+    if (byte == XS_ARRAY_KEY_BYTES)
+    {
+        qsort_r(v, n, sizeof(*v), xs_array_qsort_cmp, (void *)items);
+        return;
+    }
+
+    size_t count[256] = {0}, start[256];
+    for (size_t i = 0; i < n; i++)
+        count[xs_array_digit(v[i].key, byte)]++;
+
+    /* all in one bucket, move on to the next byte without copying */
+    if (count[xs_array_digit(v[0].key, byte)] == n)
+    {
+        xs_array_msd(v, tmp, n, byte + 1, items);
+        return;
+    }
+
+    for (size_t d = 0, sum = 0; d < 256; d++)
+    {
+        start[d] = sum;
+        sum += count[d];
+    }
+    for (size_t i = 0; i < n; i++)
+        tmp[start[xs_array_digit(v[i].key, byte)]++] = v[i];
+    memcpy(v, tmp, n * sizeof(*v));
+
+    for (size_t d = 0, lo = 0; d < 256; lo += count[d++])
+        if (count[d] > 1)
+            xs_array_msd(v + lo, tmp + lo, count[d], byte + 1, items);
+}
+
+/* The parallel sort splits on the first key byte: every thread counts and
+ * then scatters its own slice of the input, after which the 256 buckets
+ * are independent and handed out to the threads one at a time.
+ */
+typedef struct
+{
+    xs_array_pair *v, *tmp;
+    const xs *items;
+    const uint64_t *keys;
+    size_t n;
+    int threads;
+    size_t count[XS_ARRAY_MAX_THREADS][256];
+    size_t bucket_start[257];
+    pthread_barrier_t barrier;
+    /* the workers wait until the number of them that started is known */
+    pthread_mutex_t lock;
+    pthread_cond_t go;
+    bool started;
+    int next_bucket;
+} xs_array_sort_job;
+
+typedef struct
+{
+    xs_array_sort_job *job;
+    int id;
+} xs_array_sort_worker;
+
+static void *xs_array_sort_main(void *arg)
+{
+    xs_array_sort_worker *w = (xs_array_sort_worker *)arg;
+    xs_array_sort_job *job = w->job;
+
+    pthread_mutex_lock(&job->lock);
+    while (!job->started)
+        pthread_cond_wait(&job->go, &job->lock);
+    pthread_mutex_unlock(&job->lock);
+
+    size_t *count = job->count[w->id];
+    size_t lo = job->n * w->id / job->threads,
+           hi = job->n * (w->id + 1) / job->threads;
+
+    for (size_t i = lo; i < hi; i++)
+    {
+        job->tmp[i].key = job->keys[i];
+        job->tmp[i].index = i;
+        count[xs_array_digit(job->keys[i], 0)]++;
+    }
+    pthread_barrier_wait(&job->barrier);
+
+    /* where this thread's share of every bucket goes */
+    size_t start[256], sum = 0;
+    for (int d = 0; d < 256; d++)
+    {
+        for (int t = 0; t < job->threads; t++)
+        {
+            if (t == w->id)
+                start[d] = sum;
+            sum += job->count[t][d];
+        }
+        if (!w->id)
+            job->bucket_start[d + 1] = sum;
+    }
+    for (size_t i = lo; i < hi; i++)
+        job->v[start[xs_array_digit(job->tmp[i].key, 0)]++] = job->tmp[i];
+    pthread_barrier_wait(&job->barrier);
+
+    int d;
+    while ((d = __atomic_fetch_add(&job->next_bucket, 1, __ATOMIC_RELAXED)) <
+           256)
+    {
+        size_t b = job->bucket_start[d], e = job->bucket_start[d + 1];
+        if (e - b > 1)
+            xs_array_msd(job->v + b, job->tmp + b, e - b, 1, job->items);
+    }
+    return NULL;
+}
+
+/* Sort the items with up to `threads` threads */
+static inline bool xs_array_sort(xs_array *a, int threads)
+{
+    size_t n = a->size;
+    if (n < 2)
+        return true;
+
+    xs_array_pair *v = (xs_array_pair *)malloc(n * sizeof(*v)),
+                  *tmp = (xs_array_pair *)malloc(n * sizeof(*tmp));
+    xs *items = (xs *)malloc(a->capacity * sizeof(xs));
+    uint64_t *keys = (uint64_t *)malloc(a->capacity * sizeof(*keys));
+    if (!v || !tmp || !items || !keys)
+    {
+        free(v);
+        free(tmp);
+        free(items);
+        free(keys);
+        return false;
+    }
+
+    if (threads > XS_ARRAY_MAX_THREADS)
+        threads = XS_ARRAY_MAX_THREADS;
+    xs_array_sort_job *job =
+        threads > 1 && n >= XS_ARRAY_PARALLEL_MIN
+            ? (xs_array_sort_job *)calloc(1, sizeof(xs_array_sort_job))
+            : NULL;
+    if (job)
+    {
+        pthread_t tid[XS_ARRAY_MAX_THREADS];
+        xs_array_sort_worker w[XS_ARRAY_MAX_THREADS];
+
+        job->v = v;
+        job->tmp = tmp;
+        job->items = a->items;
+        job->keys = a->keys;
+        job->n = n;
+        pthread_mutex_init(&job->lock, NULL);
+        pthread_cond_init(&job->go, NULL);
+
+        /* the work is split among the threads that could be created */
+        int started = 1;
+        for (int t = 1; t < threads; t++)
+        {
+            w[t] = (xs_array_sort_worker){job, t};
+            if (pthread_create(&tid[t], NULL, xs_array_sort_main, &w[t]))
+                break;
+            started++;
+        }
+        job->threads = started;
+        pthread_barrier_init(&job->barrier, NULL, started);
+        pthread_mutex_lock(&job->lock);
+        job->started = true;
+        pthread_cond_broadcast(&job->go);
+        pthread_mutex_unlock(&job->lock);
+
+        w[0] = (xs_array_sort_worker){job, 0};
+        xs_array_sort_main(&w[0]);
+        for (int t = 1; t < started; t++)
+            pthread_join(tid[t], NULL);
+        pthread_barrier_destroy(&job->barrier);
+        pthread_cond_destroy(&job->go);
+        pthread_mutex_destroy(&job->lock);
+        free(job);
+    }
+    else
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            v[i].key = a->keys[i];
+            v[i].index = i;
+        }
+        xs_array_msd(v, tmp, n, 0, a->items);
+    }
+
+    /* move the unions into their sorted places */
+    for (size_t i = 0; i < n; i++)
+    {
+        items[i] = a->items[v[i].index];
+        keys[i] = v[i].key;
+    }
+    free(a->items);
+    free(a->keys);
+    a->items = items;
+    a->keys = keys;
+    free(v);
+    free(tmp);
+    return true;
+}
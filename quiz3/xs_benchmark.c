@@ -1,52 +1,105 @@
-#include <stdint.h>
-#include <stdio.h>
-#include <fcntl.h>
-#include <time.h>
-
+#include "suite.h"
 #include "xs.h"
 
-#define CLOCK_ID CLOCK_MONOTONIC_RAW
-#define ONE_SEC 1e9
+typedef struct
+{
+    xs s[SUITE_ITEMS], c[SUITE_ITEMS];
+} ctx_t;
+
+static xs prefix, suffix;
 
-#define SIZE 131072
+static void *ctx_create(void) { return calloc(1, sizeof(ctx_t)); }
 
-int main(int argc, char *argv[])
+static void ctx_destroy(void *ctx) { free(ctx); }
+
+static void new_all(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+        xs_new(&x->s[i], suite_input[d][i]);
+}
+
+static void new_padded_all(void *ctx, int d)
 {
-    uint8_t buf[21] = {0};
-    xs string[SIZE];
-    int32_t *tmp[SIZE];
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+        xs_new(&x->s[i], suite_padded[d][i]);
+}
 
-    struct timespec start = {0, 0};
-    struct timespec end = {0, 0};
+/* copies share large strings, a write has to detach them */
+static void new_copy_all(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    new_all(ctx, d);
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+        xs_copy_to(&x->c[i], &x->s[i]);
+}
 
-    int fd = open("/dev/urandom", O_RDONLY);
-    for (int i = 0; i < SIZE; ++i)
+static void free_all(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
     {
-        read(fd, buf, sizeof(buf) - 1);
-        string[i] = *xs_tmp((const void *)buf);
-        tmp[i] = (int32_t *)malloc(sizeof(int32_t));
+        xs_free(&x->s[i]);
+        xs_free(&x->c[i]);
     }
-    close(fd);
+}
 
-    srand(time(NULL));
+static void run_construct(void *ctx, int d) { new_all(ctx, d); }
 
-    for (int i = 0; i < SIZE; ++i)
-    {
-        ++*tmp[i];
-    }
+static void run_copy(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+        xs_copy_to(&x->c[i], &x->s[i]);
+}
 
-    clock_gettime(CLOCK_ID, &start);
-    for (int i = 0; i < 1000; ++i)
-    {
-        xs_data(&string[rand() % SIZE])[20] = 'A';
-    }
-    clock_gettime(CLOCK_ID, &end);
-    long long utime = (double)(end.tv_sec - start.tv_sec) * ONE_SEC + (end.tv_nsec - start.tv_nsec);
-    printf("%lld\n", utime);
+static void run_write(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+        xs_concat(&x->c[i], xs_tmp(""), &suffix);
+}
 
-    for (int i = 0; i < SIZE; ++i)
-    {
-        free(tmp[i]);
-    }
-    return 0;
-}
\ No newline at end of file
+static void run_concat(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+        xs_concat(&x->s[i], &prefix, &suffix);
+}
+
+static void run_trim(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+        xs_trim(&x->s[i], " ");
+}
+
+static void run_grow(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+        xs_grow(&x->s[i], 2 * xs_size(&x->s[i]) + 1);
+}
+
+static void run_free(void *ctx, int d) { free_all(ctx, d); }
+
+static const suite_op ops[] = {
+    {"construct", NULL, run_construct, free_all},
+    {"copy", new_all, run_copy, free_all},
+    {"cow_write", new_copy_all, run_write, free_all},
+    {"concat", new_all, run_concat, free_all},
+    {"trim", new_padded_all, run_trim, free_all},
+    {"grow", new_all, run_grow, free_all},
+    {"free", new_all, run_free, NULL},
+};
+
+int main(int argc, char *argv[])
+{
+    const suite_ctx ctx = {ctx_create, ctx_destroy};
+
+    xs_new(&prefix, "<<");
+    xs_new(&suffix, ">>");
+    return suite_main("xs", ops, sizeof(ops) / sizeof(ops[0]), &ctx, argc,
+                      argv);
+}
@@ -0,0 +1,379 @@
+#pragma once
+#include <math.h>
+#include <stdarg.h>
+
+#include "xs.h"
+
+/* Formatted appends, written straight into the string buffer.
+ *
+ * Each call finds out how much room it needs first, grows the string at
+ * most once and then formats in place, with no stack buffer in between.
+ * Integers are converted two digits at a time with the table used by
+ * quiz2/string_interning/unsigned.h. xs_appendf handles the common
+ * conversions itself and leaves any other format to vsnprintf.
+ *
+ * Growing may move or free the buffer, and formatting in place writes over
+ * its terminator. A %s argument that points into the string itself is
+ * thus formatted aside first, and so is anything left to vsnprintf, which
+ * cannot be checked.
+ */
+static const char xs_digit_pairs[201] = {
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899"};
+
+/* the longest uint64_t and int64_t */
+#define XS_INT_MAX_DIGITS 20
+#define XS_INT_MAX_LEN (XS_INT_MAX_DIGITS + 1)
+/* %g and %e with the default precision, and %f of anything below 1e15 */
+#define XS_DOUBLE_MAX_LEN 32
+/* output formatted aside up to this length takes no malloc */
+#define XS_FMT_BUF_LEN 256
+
+static inline int xs_u64_digits(uint64_t v)
+{
+    static const uint64_t pow10[XS_INT_MAX_DIGITS] = {
+        1ULL,
+        10ULL,
+        100ULL,
+        1000ULL,
+        10000ULL,
+        100000ULL,
+        1000000ULL,
+        10000000ULL,
+        100000000ULL,
+        1000000000ULL,
+        10000000000ULL,
+        100000000000ULL,
+        1000000000000ULL,
+        10000000000000ULL,
+        100000000000000ULL,
+        1000000000000000ULL,
+        10000000000000000ULL,
+        100000000000000000ULL,
+        1000000000000000000ULL,
+        10000000000000000000ULL,
+    };
+    /* floor(log10) from floor(log2), off by at most one */
+    int t = (64 - __builtin_clzll(v | 1)) * 1233 >> 12;
+    return t + (v >= pow10[t]) + !v;
+}
+
+/* Write v without a terminator, return its length */
+static inline size_t xs_write_u64(char *dest, uint64_t v)
+{
+    int size = xs_u64_digits(v);
+    char *c = dest + size;
+
+    while (v >= 100)
+    {
+        c -= 2;
+        memcpy(c, xs_digit_pairs + 2 * (v % 100), 2);
+        v /= 100;
+    }
+    if (v >= 10)
+        memcpy(c - 2, xs_digit_pairs + 2 * v, 2);
+    else
+        c[-1] = '0' + v;
+    return size;
+}
+
+static inline size_t xs_write_i64(char *dest, int64_t v)
+{
+    if (v >= 0)
+        return xs_write_u64(dest, v);
+    *dest = '-';
+    return 1 + xs_write_u64(dest + 1, -(uint64_t)v);
+}
+
+/* Make room for extra more bytes and return where they go */
+static char *xs_append_begin(xs *x, size_t extra)
+{
+    char *data = xs_data(x);
+    xs_cow_lazy_copy(x, &data);
+    xs_grow(x, xs_size(x) + extra);
+    return xs_data(x) + xs_size(x);
+}
+
+/* Account for the len bytes written by the caller at p. A terminator
+ * written after them may have hit the flags of a short string, which are
+ * thus not read.
+ */
+static xs *xs_append_end(xs *x, const char *p, size_t len)
+{
+    size_t size = p + len - xs_data(x);
+    xs_data(x)[size] = 0;
+    if (xs_is_ptr(x))
+        x->size = size;
+    else
+        x->space_left = SHORT_STRING_LEN - size;
+    xs_invalidate_caches(x);
+    return x;
+}
+
+static inline xs *xs_append_u64(xs *x, uint64_t v)
+{
+    char *p = xs_append_begin(x, XS_INT_MAX_DIGITS);
+    return xs_append_end(x, p, xs_write_u64(p, v));
+}
+
+static inline xs *xs_append_i64(xs *x, int64_t v)
+{
+    char *p = xs_append_begin(x, XS_INT_MAX_LEN);
+    return xs_append_end(x, p, xs_write_i64(p, v));
+}
+
+static inline xs *xs_append_cstr(xs *x, const char *s)
+{
+    size_t len = strlen(s);
+    char *p = xs_append_begin(x, len);
+    memcpy(p, s, len);
+    return xs_append_end(x, p, len);
+}
+
+/* As printf %g */
+static inline xs *xs_append_double(xs *x, double v)
+{
+    char *p = xs_append_begin(x, XS_DOUBLE_MAX_LEN);
+    return xs_append_end(x, p, snprintf(p, XS_DOUBLE_MAX_LEN + 1, "%g", v));
+}
+
+/* A conversion xs_appendf handles itself: one of d i u c s f e g %, with an
+ * optional l, ll or z for the integers, and no flags, width or precision.
+ */
+typedef struct
+{
+    char conv, mod;
+    int len;
+} xs_fmt_spec;
+
+static bool xs_fmt_parse(const char *f, xs_fmt_spec *spec)
+{
+    const char *p = f;
+    spec->mod = 0;
+    if (*p == 'z')
+        spec->mod = *p++;
+    else if (*p == 'l')
+    {
+        spec->mod = *p++;
+        if (*p == 'l')
+            spec->mod = 'L', p++;
+    }
+    spec->conv = *p++;
+    spec->len = p - f;
+
+    switch (spec->conv)
+    {
+    case 'd':
+    case 'i':
+    case 'u':
+        return true;
+    case 'c':
+    case 's':
+    case 'f':
+    case 'e':
+    case 'g':
+    case '%':
+        return !spec->mod || (spec->mod == 'l' && spec->conv != 's' &&
+                              spec->conv != 'c' && spec->conv != '%');
+    }
+    return false;
+}
+
+static inline int64_t xs_fmt_signed(const xs_fmt_spec *spec, va_list *ap)
+{
+    switch (spec->mod)
+    {
+    case 'l':
+        return va_arg(*ap, long);
+    case 'L':
+        return va_arg(*ap, long long);
+    case 'z':
+        return va_arg(*ap, ssize_t);
+    }
+    return va_arg(*ap, int);
+}
+
+static inline uint64_t xs_fmt_unsigned(const xs_fmt_spec *spec, va_list *ap)
+{
+    switch (spec->mod)
+    {
+    case 'l':
+        return va_arg(*ap, unsigned long);
+    case 'L':
+        return va_arg(*ap, unsigned long long);
+    case 'z':
+        return va_arg(*ap, size_t);
+    }
+    return va_arg(*ap, unsigned);
+}
+
+/* Whether s points into the buffer of x, which appending to x may move,
+ * free or overwrite. Static storage stays as it is.
+ */
+static inline bool xs_fmt_aliases(const xs *x, const char *s)
+{
+    uintptr_t lo, hi;
+    if (!xs_is_ptr(x))
+    {
+        lo = (uintptr_t)x->data;
+        hi = lo + sizeof(x->data);
+    }
+    else if (xs_is_static(x))
+        return false;
+    else
+    {
+        /* a slice may hold the last reference to the whole buffer */
+        uintptr_t used = (uintptr_t)(xs_data(x) + xs_size(x) + 1);
+        lo = (uintptr_t)x->ptr;
+        hi = lo + xs_buffer_size(x);
+        if (hi < used)
+            hi = used;
+    }
+    return (uintptr_t)s >= lo && (uintptr_t)s < hi;
+}
+
+/* With dest NULL, an upper bound of the output length or -1 if fmt needs
+ * vsnprintf, and *alias set if a %s argument points into x. Otherwise the
+ * output is written to dest, with room up to end, and its length returned.
+ */
+static ssize_t xs_fmt_run(char *dest, char *end, const char *fmt,
+                          va_list *ap, const xs *x, bool *alias)
+{
+    size_t len = 0;
+
+    for (const char *f = fmt; *f; f++)
+    {
+        const char *lit = f;
+        while (*f && *f != '%')
+            f++;
+        if (f > lit)
+        {
+            if (dest)
+                memcpy(dest + len, lit, f - lit);
+            len += f - lit;
+        }
+        if (!*f)
+            break;
+
+        xs_fmt_spec spec;
+        if (!xs_fmt_parse(++f, &spec))
+            return -1;
+        f += spec.len - 1;
+
+        switch (spec.conv)
+        {
+        case 'd':
+        case 'i':
+        {
+            int64_t v = xs_fmt_signed(&spec, ap);
+            len += dest ? xs_write_i64(dest + len, v) : XS_INT_MAX_LEN;
+            break;
+        }
+        case 'u':
+        {
+            uint64_t v = xs_fmt_unsigned(&spec, ap);
+            len += dest ? xs_write_u64(dest + len, v) : XS_INT_MAX_DIGITS;
+            break;
+        }
+        case 'c':
+            if (dest)
+                dest[len] = va_arg(*ap, int);
+            else
+                (void)va_arg(*ap, int);
+            len++;
+            break;
+        case '%':
+            if (dest)
+                dest[len] = '%';
+            len++;
+            break;
+        case 's':
+        {
+            const char *s = va_arg(*ap, const char *);
+            size_t n;
+            if (!s)
+                s = "(null)";
+            n = strlen(s);
+            if (dest)
+                memcpy(dest + len, s, n);
+            else if (xs_fmt_aliases(x, s))
+                *alias = true;
+            len += n;
+            break;
+        }
+        default:
+        {
+            char conv[] = {'%', spec.conv, 0};
+            double v = va_arg(*ap, double);
+            if (dest)
+                len += snprintf(dest + len, end - (dest + len), conv, v);
+            else if (spec.conv != 'f' || fabs(v) < 1e15)
+                len += XS_DOUBLE_MAX_LEN;
+            else
+                len += snprintf(NULL, 0, conv, v);
+            break;
+        }
+        }
+    }
+    return len;
+}
+
+/* Append as printf does, growing x at most once. Arguments may point into
+ * x itself.
+ */
+static inline xs *xs_appendf(xs *x, const char *fmt, ...)
+{
+    va_list ap, aq;
+    va_start(ap, fmt);
+    va_copy(aq, ap);
+
+    bool alias = false;
+    ssize_t bound = xs_fmt_run(NULL, NULL, fmt, &aq, x, &alias);
+    va_end(aq);
+    if (bound >= 0 && !alias)
+    {
+        char *p = xs_append_begin(x, bound);
+        size_t len = xs_fmt_run(p, xs_data(x) + xs_capacity(x) + 1, fmt, &ap,
+                                NULL, NULL);
+        va_end(ap);
+        return xs_append_end(x, p, len);
+    }
+
+    /* All arguments are read before x changes, into buf or a larger tmp */
+    char buf[XS_FMT_BUF_LEN], *tmp = buf;
+    int len;
+    if (bound >= 0)
+    {
+        if ((size_t)bound >= sizeof(buf))
+            tmp = (char *)malloc(bound + 1);
+        len = tmp ? xs_fmt_run(tmp, tmp + bound + 1, fmt, &ap, NULL, NULL)
+                  : -1;
+    }
+    else
+    {
+        va_copy(aq, ap);
+        len = vsnprintf(buf, sizeof(buf), fmt, aq);
+        va_end(aq);
+        if (len >= (int)sizeof(buf) && (tmp = (char *)malloc(len + 1)))
+            vsnprintf(tmp, len + 1, fmt, ap);
+    }
+    va_end(ap);
+
+    if (len >= 0 && tmp)
+    {
+        char *p = xs_append_begin(x, len);
+        memcpy(p, tmp, len);
+        xs_append_end(x, p, len);
+    }
+    if (tmp != buf)
+        free(tmp);
+    return x;
+}
@@ -0,0 +1,79 @@
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include <utility>
+
+#include "xs.hpp"
+#include "xs_intern.h"
+
+/* xs.hpp included from two translation units, see xs_hpp_test_tu.cpp */
+xs_string xs_hpp_test_join(const xs_string &a, const xs_string &b);
+xs_string xs_hpp_test_intern(const char *p);
+
+/* a large string, the kind that has a refcount */
+static const std::string big(LARGE_STRING_LEN + 44, 'x');
+
+/* Moves hand the buffer over as it is and leave an empty short string */
+static void test_move()
+{
+    xs_string a(big);
+    const char *p = a.data();
+
+    xs_string b(std::move(a));
+    assert(b.data() == p && xs_get_refcnt(b.get()) == 1);
+    assert(a.empty() && !xs_is_ptr(a.get()));
+
+    xs_string c("short");
+    c = std::move(b);
+    assert(c.data() == p && xs_get_refcnt(c.get()) == 1);
+    assert(b.empty() && !xs_is_ptr(b.get()));
+}
+
+/* Copies share the buffer, and each of them drops its reference once */
+static void test_copy()
+{
+    xs keep;
+    {
+        xs_string a(big);
+        xs_copy_to(&keep, a.get());
+        assert(xs_get_refcnt(&keep) == 2);
+
+        xs_string b(a);
+        assert(b.data() == a.data() && xs_get_refcnt(&keep) == 3);
+        xs_string c("short");
+        c = b;
+        assert(c.data() == a.data() && xs_get_refcnt(&keep) == 4);
+        c = a;
+        assert(xs_get_refcnt(&keep) == 4);
+    }
+    assert(xs_get_refcnt(&keep) == 1);
+    assert(std::string_view(xs_data(&keep), xs_size(&keep)) == big);
+    xs_free(&keep);
+}
+
+/* Both translation units intern into the same set */
+static void test_intern()
+{
+    const char *text = "interned from two translation units";
+    xs_string a(text);
+    xs_intern(a.get());
+    xs_string b = xs_hpp_test_intern(text);
+    assert(xs_is_interned(a.get()) && xs_is_interned(b.get()));
+    assert(a.data() == b.data() && a == b);
+}
+
+int main()
+{
+    xs_string s = xs_hpp_test_join("header", "only");
+    assert(std::string_view(s) == "header-only");
+
+    static const char text[] = "static storage longer than a short string";
+    assert(xs_string::from_static(text, sizeof(text) - 1).data() == text);
+    xs_string lit = xs_string_literal("a literal longer than a short string");
+    assert(std::string_view(lit) == "a literal longer than a short string");
+    test_move();
+    test_copy();
+    test_intern();
+    std::printf("ok\n");
+    return 0;
+}
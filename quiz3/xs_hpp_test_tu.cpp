@@ -0,0 +1,17 @@
+#include "xs.hpp"
+#include "xs_intern.h"
+
+xs_string xs_hpp_test_join(const xs_string &a, const xs_string &b)
+{
+    xs_string r(a);
+    r += "-";
+    r += b;
+    return r;
+}
+
+xs_string xs_hpp_test_intern(const char *p)
+{
+    xs_string r(p);
+    xs_intern(r.get());
+    return r;
+}
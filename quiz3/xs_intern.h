@@ -0,0 +1,101 @@
+#pragma once
+#include "xs_map.h"
+
+/* Process-wide set of interned strings.
+ *
+ * xs_intern makes a string share the one buffer the set holds for its
+ * content, as xs_copy does, so repeated strings are stored once and two
+ * interned strings are equal exactly when their buffers are the same.
+ * Medium strings are interned with a large string header to get a
+ * refcount. The set keeps a reference to every buffer, hence interned
+ * buffers are never written in place: writes copy them out first.
+ *
+ * The set is split in shards by hash, each a spinlocked xs_map. Strings
+ * interned from several threads are shared across them, build with
+ * XS_ATOMIC_REFCNT then. Interned strings live until the process exits.
+ * The shards are XS_SHARED, hence a single set for all translation units.
+ */
+#define XS_INTERN_SHARD_BITS 6
+
+typedef struct
+{
+    int lock;
+    xs_map map;
+} xs_intern_shard;
+
+XS_SHARED xs_intern_shard xs_intern_shards[1 << XS_INTERN_SHARD_BITS];
+
+static inline void xs_intern_lock(int *lock)
+{
+    while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE))
+        while (__atomic_load_n(lock, __ATOMIC_RELAXED))
+#ifdef XS_HAVE_X86
+            _mm_pause();
+#else
+            ;
+#endif
+}
+
+static inline void xs_intern_unlock(int *lock)
+{
+    __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
+
+/* A heap buffer with a header for len bytes, outside of any scope arena */
+static void xs_intern_new(xs *x, const char *p, size_t len, uint32_t hash)
+{
+    int depth = xs_arena.depth;
+
+    *x = xs_literal_empty();
+    x->capacity = ilog2(len + 1) + 1;
+    x->size = len;
+    x->is_ptr = true;
+    xs_arena.depth = 0;
+    /* the length only picks the layout, the capacity is set above */
+    xs_allocate_data(x, LARGE_STRING_LEN, 0);
+    xs_arena.depth = depth;
+    memcpy(xs_data(x), p, len);
+    xs_data(x)[len] = 0;
+    xs_set_hash_cache(x, hash);
+}
+
+/* Replace x with the interned string of the same content, interning it
+ * first if needed. Short strings are left as they are: they are compared
+ * inline anyway.
+ */
+static inline xs *xs_intern(xs *x)
+{
+    if (!xs_is_ptr(x) || xs_is_interned(x))
+        return x;
+
+    uint32_t hash = xs_hash(x);
+    xs_intern_shard *shard =
+        &xs_intern_shards[hash >> (32 - XS_INTERN_SHARD_BITS)];
+
+    xs_intern_lock(&shard->lock);
+    xs_map_slot *slot =
+        shard->map.count ? xs_map_probe(&shard->map, x, hash) : NULL;
+    if (slot && slot->hash)
+    {
+        xs_inc_refcnt(&slot->key);
+        xs_free(x);
+        *x = slot->key;
+    }
+    else
+    {
+        /* a large string that owns its whole buffer is kept as it is */
+        if (!xs_is_large_string(x) || xs_is_slice(x) || xs_is_arena(x))
+        {
+            xs in;
+            xs_intern_new(&in, xs_data(x), xs_size(x), hash);
+            xs_free(x);
+            *x = in;
+        }
+#ifdef XS_32
+        x->is_interned = 1;
+#endif
+        xs_map_put(&shard->map, x);
+    }
+    xs_intern_unlock(&shard->lock);
+    return x;
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include "xs.h"
+
+/* Open-addressing hash map keyed by xs, with linear probing.
+ *
+ * Each slot holds the key union itself, so short keys live in the table and
+ * a lookup touches no other memory. Longer keys are stored as xs_copy, large
+ * ones thus share the caller's buffer and its cached hash, unless that is a
+ * scope arena. The key hash is kept in the slot to skip most comparisons,
+ * 0 marks an empty slot.
+ */
+#define XS_MAP_MIN_CAPACITY 16 /* must be power of 2 */
+
+typedef struct
+{
+    uint32_t hash;
+    xs key;
+    void *value;
+} xs_map_slot;
+
+typedef struct
+{
+    xs_map_slot *slots;
+    size_t capacity, count;
+} xs_map;
+
+static inline void xs_map_init(xs_map *m)
+{
+    m->slots = NULL;
+    m->capacity = m->count = 0;
+}
+
+static inline void xs_map_free(xs_map *m)
+{
+    for (size_t i = 0; i < m->capacity; i++)
+        if (m->slots[i].hash)
+            xs_free(&m->slots[i].key);
+    free(m->slots);
+    xs_map_init(m);
+}
+
+/* slot holding key, or the empty slot where it would go */
+static inline xs_map_slot *xs_map_probe(const xs_map *m, const xs *key,
+                                        uint32_t hash)
+{
+    size_t mask = m->capacity - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        xs_map_slot *slot = &m->slots[i];
+        if (!slot->hash || (slot->hash == hash && xs_equal(&slot->key, key)))
+            return slot;
+    }
+}
+
+static inline void xs_map_resize(xs_map *m, size_t capacity)
+{
+    xs_map_slot *old = m->slots;
+    size_t old_capacity = m->capacity;
+
+    m->slots = (xs_map_slot *)calloc(capacity, sizeof(xs_map_slot));
+    m->capacity = capacity;
+    for (size_t i = 0; i < old_capacity; i++)
+    {
+        if (!old[i].hash)
+            continue;
+        size_t j = old[i].hash & (capacity - 1);
+        while (m->slots[j].hash)
+            j = (j + 1) & (capacity - 1);
+        m->slots[j] = old[i];
+    }
+    free(old);
+}
+
+/* Value of key, or NULL if it is absent */
+static inline void **xs_map_get(const xs_map *m, const xs *key)
+{
+    if (!m->count)
+        return NULL;
+    xs_map_slot *slot = xs_map_probe(m, key, xs_hash(key));
+    return slot->hash ? &slot->value : NULL;
+}
+
+/* Value of key, inserted as NULL first if it is absent */
+static inline void **xs_map_put(xs_map *m, const xs *key)
+{
+    /* keep the load factor under 3/4 */
+    if ((m->count + 1) * 4 > m->capacity * 3)
+        xs_map_resize(m, m->capacity ? m->capacity * 2 : XS_MAP_MIN_CAPACITY);
+
+    uint32_t hash = xs_hash(key);
+    xs_map_slot *slot = xs_map_probe(m, key, hash);
+    if (!slot->hash)
+    {
+        slot->hash = hash;
+        xs_escape(xs_copy_to(&slot->key, key));
+        slot->value = NULL;
+        m->count++;
+    }
+    return &slot->value;
+}
+
+/* Remove key, shifting back the entries that probed past its slot */
+static inline bool xs_map_remove(xs_map *m, const xs *key)
+{
+    if (!m->count)
+        return false;
+
+    size_t mask = m->capacity - 1;
+    xs_map_slot *slot = xs_map_probe(m, key, xs_hash(key));
+    if (!slot->hash)
+        return false;
+
+    xs_free(&slot->key);
+    m->count--;
+
+    size_t hole = slot - m->slots;
+    for (size_t i = (hole + 1) & mask; m->slots[i].hash; i = (i + 1) & mask)
+    {
+        /* move it if its home is not within (hole, i] */
+        size_t home = m->slots[i].hash & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            m->slots[hole] = m->slots[i];
+            hole = i;
+        }
+    }
+    m->slots[hole].hash = 0;
+    return true;
+}
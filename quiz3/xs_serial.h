@@ -0,0 +1,183 @@
+#pragma once
+#include <limits.h>
+#include <sys/uio.h>
+
+#include "xs.h"
+
+/* Binary format for arrays of xs:
+ *
+ *   header   magic "XSA1", count, size of the lengths, size of the data
+ *   lengths  every string length as a LEB128 varint
+ *   data     every string followed by a NUL byte
+ *
+ * Integers in the header are in host byte order. The data section is
+ * written straight from xs_data with writev and read back with a single
+ * read into one large buffer: strings that do not fit the short string
+ * become slices of it, the others are copied inline. The buffer lives as
+ * long as any slice does, and each slice is NUL-terminated even though it
+ * is a slice.
+ */
+#define XS_SERIAL_MAGIC "XSA1"
+
+typedef struct
+{
+    char magic[4];
+    uint32_t reserved;
+    uint64_t count, lengths_size, data_size;
+} xs_serial_header;
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+/* Write all of iov, which is modified on partial writes */
+static bool xs_writev_all(int fd, struct iovec *iov, size_t n)
+{
+    while (n)
+    {
+        ssize_t w = writev(fd, iov, n < IOV_MAX ? n : IOV_MAX);
+        if (w < 0)
+            return false;
+        for (; n && (size_t)w >= iov->iov_len; iov++, n--)
+            w -= iov->iov_len;
+        if (n)
+        {
+            iov->iov_base = (char *)iov->iov_base + w;
+            iov->iov_len -= w;
+        }
+    }
+    return true;
+}
+
+static bool xs_read_all(int fd, void *buf, size_t len)
+{
+    for (char *p = (char *)buf; len;)
+    {
+        ssize_t r = read(fd, p, len);
+        if (r <= 0)
+            return false;
+        p += r;
+        len -= r;
+    }
+    return true;
+}
+
+static inline bool xs_write_array(int fd, const xs *v, size_t n)
+{
+    static const char nul = 0;
+    xs_serial_header h = {XS_SERIAL_MAGIC, 0, n, 0, 0};
+    uint8_t *lengths = (uint8_t *)malloc(n * 10 + 1);
+    /* two entries for a slice, which has no NUL after it */
+    struct iovec *iov = (struct iovec *)malloc((2 + 2 * n) * sizeof(*iov));
+    size_t k = 2;
+    bool ok = false;
+
+    if (!lengths || !iov)
+        goto out;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        size_t len = xs_size(&v[i]);
+        for (; len >= 0x80; len >>= 7)
+            lengths[h.lengths_size++] = len | 0x80;
+        lengths[h.lengths_size++] = len;
+
+        len = xs_size(&v[i]);
+        h.data_size += len + 1;
+        if (xs_is_slice(&v[i]))
+        {
+            iov[k++] = (struct iovec){xs_data(&v[i]), len};
+            iov[k++] = (struct iovec){(void *)&nul, 1};
+        }
+        else
+            iov[k++] = (struct iovec){xs_data(&v[i]), len + 1};
+    }
+    iov[0] = (struct iovec){&h, sizeof(h)};
+    iov[1] = (struct iovec){lengths, h.lengths_size};
+    ok = xs_writev_all(fd, iov, k);
+
+out:
+    free(lengths);
+    free(iov);
+    return ok;
+}
+
+/* Array of the strings read from fd and their number in *n, NULL on error.
+ * Each string is to be released with xs_free and the array with free.
+ */
+static inline xs *xs_read_array(int fd, size_t *n)
+{
+    xs_serial_header h;
+    struct stat st;
+    if (!xs_read_all(fd, &h, sizeof(h)) ||
+        memcmp(h.magic, XS_SERIAL_MAGIC, sizeof(h.magic)) ||
+        h.count > SIZE_MAX / 10 / sizeof(xs) ||
+        h.lengths_size > h.count * 10 || h.data_size < h.count ||
+        h.data_size > MAX_STR_LEN)
+        return NULL;
+
+    /* a file has to hold what the header announces, before it is allocated */
+    off_t pos = lseek(fd, 0, SEEK_CUR);
+    if (pos >= 0 && !fstat(fd, &st) && S_ISREG(st.st_mode))
+    {
+        uint64_t left = st.st_size > pos ? (uint64_t)(st.st_size - pos) : 0;
+        if (h.lengths_size > left || h.data_size > left - h.lengths_size)
+            return NULL;
+    }
+
+    /* +1: an empty array is no error */
+    uint8_t *lengths = (uint8_t *)malloc(h.lengths_size + 1);
+    xs *v = (xs *)malloc((h.count + 1) * sizeof(xs)),
+       block = xs_literal_empty();
+    size_t i = 0;
+    if (!lengths || !v || !xs_read_all(fd, lengths, h.lengths_size))
+        goto fail;
+
+    /* one buffer for all of the data, at least a large string */
+    if (!xs_grow(&block, h.data_size > LARGE_STRING_LEN ? h.data_size
+                                                        : LARGE_STRING_LEN))
+        goto fail;
+    char *data = xs_data(&block);
+    if (!xs_read_all(fd, data, h.data_size))
+        goto fail;
+    block.size = h.data_size;
+
+    size_t p = 0, off = 0;
+    for (; i < h.count; i++)
+    {
+        size_t len = 0;
+        uint8_t b = 0x80;
+        for (int shift = 0; p < h.lengths_size && shift < 64; shift += 7)
+        {
+            b = lengths[p++];
+            len |= (size_t)(b & 0x7F) << shift;
+            if (!(b & 0x80))
+                break;
+        }
+        /* a varint cut off by the end of the lengths, or none at all */
+        if ((b & 0x80) || len >= h.data_size - off || data[off + len])
+            goto fail;
+
+        if (len <= SHORT_STRING_LEN)
+            xs_new_len(&v[i], data + off, len);
+        else
+            xs_slice(&v[i], &block, off, len);
+        off += len + 1;
+    }
+    /* nothing may be left over, a longer input is no array of ours */
+    if (off != h.data_size || p != h.lengths_size)
+        goto fail;
+
+    free(lengths);
+    xs_free(&block);
+    *n = h.count;
+    return v;
+
+fail:
+    while (i)
+        xs_free(&v[--i]);
+    free(lengths);
+    free(v);
+    xs_free(&block);
+    return NULL;
+}
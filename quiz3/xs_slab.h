@@ -0,0 +1,269 @@
+#pragma once
+#include <pthread.h>
+
+#include "xs.h"
+
+/* Size-class pool for xs heap buffers, enabled with
+ * xs_set_allocator(&xs_slab_allocator).
+ *
+ * Buffers are always a power of two, plus the header for large strings, so
+ * every class is 2^k bytes with room for the header. Each thread keeps its
+ * own free list per class, which takes no locking. Chunks are aligned to
+ * their size and record the thread that carved them. A block freed by
+ * another thread, which happens with XS_ATOMIC_REFCNT, goes to a locked
+ * global overflow list instead. A thread that runs out takes that list
+ * before it carves a new chunk, and a thread that exits hands its own
+ * lists over to it.
+ *
+ * Chunks whose blocks are all on the overflow lists go back to malloc in
+ * xs_slab_trim, which also runs whenever a thread exits.
+ *
+ * The lists are XS_SHARED, so strings may be allocated in one translation
+ * unit and freed in another.
+ */
+#define XS_SLAB_MIN_SHIFT 5  /* 32 bytes */
+#define XS_SLAB_MAX_SHIFT 12 /* 4096 bytes */
+#define XS_SLAB_CLASSES (XS_SLAB_MAX_SHIFT - XS_SLAB_MIN_SHIFT + 1)
+#define XS_SLAB_SLACK ((XS_HEADER_SIZE + 7) & ~7)
+#define XS_SLAB_CHUNK_SIZE (64 << 10)
+
+struct __xs_slab_block
+{
+    struct __xs_slab_block *next;
+};
+
+struct __xs_slab_chunk
+{
+    const void *owner;
+    /* blocks seen on the overflow list, only used by xs_slab_trim */
+    unsigned free;
+};
+
+#define XS_SLAB_CHUNK_HEADER                                          \
+    ((sizeof(struct __xs_slab_chunk) + _Alignof(max_align_t) - 1) &   \
+     ~(_Alignof(max_align_t) - 1))
+
+XS_SHARED __thread struct __xs_slab_block *xs_slab_free_list[XS_SLAB_CLASSES];
+
+struct __xs_slab_overflow
+{
+    pthread_mutex_t lock;
+    pthread_once_t once;
+    pthread_key_t key;
+    struct __xs_slab_block *free_list[XS_SLAB_CLASSES];
+    /* chunks currently carved */
+    size_t chunks;
+};
+
+XS_SHARED struct __xs_slab_overflow xs_slab_overflow = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_ONCE_INIT};
+
+static inline size_t xs_slab_block_size(int class)
+{
+    return ((size_t)1 << (class + XS_SLAB_MIN_SHIFT)) + XS_SLAB_SLACK;
+}
+
+static inline size_t xs_slab_chunk_blocks(int class)
+{
+    return (XS_SLAB_CHUNK_SIZE - XS_SLAB_CHUNK_HEADER) /
+           xs_slab_block_size(class);
+}
+
+/* -1 if the size is left to malloc */
+static inline int xs_slab_class(size_t size)
+{
+    if (size > xs_slab_block_size(XS_SLAB_CLASSES - 1))
+        return -1;
+    if (size <= xs_slab_block_size(0))
+        return 0;
+    /* smallest k with 2^k + slack >= size */
+    return 64 - __builtin_clzl(size - XS_SLAB_SLACK - 1) - XS_SLAB_MIN_SHIFT;
+}
+
+static inline struct __xs_slab_chunk *xs_slab_chunk(const void *ptr)
+{
+    return (struct __xs_slab_chunk *)((uintptr_t)ptr &
+                                      ~(uintptr_t)(XS_SLAB_CHUNK_SIZE - 1));
+}
+
+/* The calling thread, as recorded in the chunks it carves. An exited
+ * thread's id may be taken by a new one, which then owns its chunks.
+ */
+static inline const void *xs_slab_self(void)
+{
+    return xs_slab_free_list;
+}
+
+/* Give back to malloc the chunks whose blocks are all on the overflow
+ * lists, that is neither in use nor on the list of a live thread.
+ */
+static void xs_slab_trim(void)
+{
+    pthread_mutex_lock(&xs_slab_overflow.lock);
+    for (int class = 0; class < XS_SLAB_CLASSES; ++class)
+    {
+        struct __xs_slab_block **list = &xs_slab_overflow.free_list[class];
+        unsigned blocks = xs_slab_chunk_blocks(class);
+        for (struct __xs_slab_block *b = *list; b; b = b->next)
+            xs_slab_chunk(b)->free++;
+
+        /* a whole chunk counts on from blocks to twice that as its blocks
+         * are unlinked, and goes once the last one is
+         */
+        while (*list)
+        {
+            struct __xs_slab_chunk *c = xs_slab_chunk(*list);
+            if (c->free < blocks)
+            {
+                list = &(*list)->next;
+                continue;
+            }
+            *list = (*list)->next;
+            if (++c->free == 2 * blocks)
+            {
+                free(c);
+                xs_slab_overflow.chunks--;
+            }
+        }
+
+        for (struct __xs_slab_block *b = xs_slab_overflow.free_list[class]; b;
+             b = b->next)
+            xs_slab_chunk(b)->free = 0;
+    }
+    pthread_mutex_unlock(&xs_slab_overflow.lock);
+}
+
+/* Hand the lists of an exiting thread over to the overflow lists */
+static void xs_slab_thread_exit(void *unused)
+{
+    pthread_mutex_lock(&xs_slab_overflow.lock);
+    for (int class = 0; class < XS_SLAB_CLASSES; ++class)
+    {
+        struct __xs_slab_block *b = xs_slab_free_list[class];
+        while (b)
+        {
+            struct __xs_slab_block *next = b->next;
+            b->next = xs_slab_overflow.free_list[class];
+            xs_slab_overflow.free_list[class] = b;
+            b = next;
+        }
+        xs_slab_free_list[class] = NULL;
+    }
+    pthread_mutex_unlock(&xs_slab_overflow.lock);
+    xs_slab_trim();
+}
+
+static void xs_slab_key_init(void)
+{
+    pthread_key_create(&xs_slab_overflow.key, xs_slab_thread_exit);
+}
+
+/* Take the overflow list of the class, or else carve a new chunk */
+static void xs_slab_refill(int class)
+{
+    static __thread bool registered;
+    if (!registered)
+    {
+        /* any non-NULL value, for the destructor to run */
+        pthread_once(&xs_slab_overflow.once, xs_slab_key_init);
+        pthread_setspecific(xs_slab_overflow.key, xs_slab_free_list);
+        registered = true;
+    }
+
+    pthread_mutex_lock(&xs_slab_overflow.lock);
+    struct __xs_slab_block *head = xs_slab_overflow.free_list[class];
+    xs_slab_overflow.free_list[class] = NULL;
+    if (!head)
+        xs_slab_overflow.chunks++;
+    pthread_mutex_unlock(&xs_slab_overflow.lock);
+    if (head)
+    {
+        /* those blocks now belong to this thread, wherever they came from */
+        xs_slab_free_list[class] = head;
+        return;
+    }
+
+    size_t bsize = xs_slab_block_size(class);
+    struct __xs_slab_chunk *c =
+        aligned_alloc(XS_SLAB_CHUNK_SIZE, XS_SLAB_CHUNK_SIZE);
+    if (!c)
+    {
+        pthread_mutex_lock(&xs_slab_overflow.lock);
+        xs_slab_overflow.chunks--;
+        pthread_mutex_unlock(&xs_slab_overflow.lock);
+        return;
+    }
+    c->owner = xs_slab_self();
+    c->free = 0;
+
+    char *chunk = (char *)c + XS_SLAB_CHUNK_HEADER;
+    for (size_t i = 0; i < xs_slab_chunk_blocks(class); i++)
+    {
+        struct __xs_slab_block *b =
+            (struct __xs_slab_block *)(chunk + i * bsize);
+        b->next = head;
+        head = b;
+    }
+    xs_slab_free_list[class] = head;
+}
+
+static void *xs_slab_alloc(size_t size)
+{
+    int class = xs_slab_class(size);
+    if (class < 0)
+        return malloc(size);
+
+    if (!xs_slab_free_list[class])
+        xs_slab_refill(class);
+
+    struct __xs_slab_block *b = xs_slab_free_list[class];
+    if (b)
+        xs_slab_free_list[class] = b->next;
+    return b;
+}
+
+static void xs_slab_free(void *ptr, size_t size)
+{
+    int class = xs_slab_class(size);
+    if (class < 0)
+    {
+        free(ptr);
+        return;
+    }
+
+    struct __xs_slab_block *b = ptr;
+    if (xs_slab_chunk(ptr)->owner == xs_slab_self())
+    {
+        b->next = xs_slab_free_list[class];
+        xs_slab_free_list[class] = b;
+        return;
+    }
+    pthread_mutex_lock(&xs_slab_overflow.lock);
+    b->next = xs_slab_overflow.free_list[class];
+    xs_slab_overflow.free_list[class] = b;
+    pthread_mutex_unlock(&xs_slab_overflow.lock);
+}
+
+static void *xs_slab_realloc(void *ptr, size_t old_size, size_t size)
+{
+    int from = xs_slab_class(old_size), to = xs_slab_class(size);
+
+    if (from < 0 && to < 0)
+        return realloc(ptr, size);
+    if (from == to)
+        return ptr;
+
+    void *p = xs_slab_alloc(size);
+    if (p)
+    {
+        memcpy(p, ptr, old_size < size ? old_size : size);
+        xs_slab_free(ptr, old_size);
+    }
+    return p;
+}
+
+static const xs_allocator xs_slab_allocator = {
+    .alloc = xs_slab_alloc,
+    .realloc = xs_slab_realloc,
+    .free = xs_slab_free,
+};
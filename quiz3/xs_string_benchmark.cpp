@@ -0,0 +1,117 @@
+#include <new>
+
+#include "suite.h"
+#include "xs.hpp"
+
+/* string_benchmark.cpp with xs_string in place of std::string */
+struct ctx_t
+{
+    xs_string s[SUITE_ITEMS], c[SUITE_ITEMS];
+};
+
+static const xs_string prefix = "<<", suffix = ">>";
+
+static void *ctx_create(void) { return new ctx_t; }
+
+static void ctx_destroy(void *ctx) { delete (ctx_t *)ctx; }
+
+static void new_all(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+        x->s[i] = suite_input[d][i];
+}
+
+static void new_padded_all(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+        x->s[i] = suite_padded[d][i];
+}
+
+static void new_copy_all(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    new_all(ctx, d);
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+        x->c[i] = x->s[i];
+}
+
+static void free_all(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+    {
+        x->s[i].clear();
+        x->c[i].clear();
+    }
+}
+
+static void run_construct(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+        new (&x->s[i]) xs_string(suite_input[d][i]);
+}
+
+/* run_construct builds the objects again in place */
+static void destruct_all(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+        x->s[i].~xs_string();
+}
+
+static void run_copy(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+        x->c[i] = x->s[i];
+}
+
+static void run_write(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+        x->c[i] += suffix;
+}
+
+static void run_concat(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+        x->s[i].concat(prefix, suffix);
+}
+
+static void run_trim(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+        x->s[i].trim(" ");
+}
+
+static void run_grow(void *ctx, int d)
+{
+    ctx_t *x = (ctx_t *)ctx;
+    for (int i = 0; i < SUITE_ITEMS; ++i)
+        x->s[i].reserve(2 * x->s[i].size() + 1);
+}
+
+static void run_free(void *ctx, int d) { free_all(ctx, d); }
+
+static const suite_op ops[] = {
+    {"construct", destruct_all, run_construct, free_all},
+    {"copy", new_all, run_copy, free_all},
+    {"cow_write", new_copy_all, run_write, free_all},
+    {"concat", new_all, run_concat, free_all},
+    {"trim", new_padded_all, run_trim, free_all},
+    {"grow", new_all, run_grow, free_all},
+    {"free", new_all, run_free, NULL},
+};
+
+int main(int argc, char *argv[])
+{
+    const suite_ctx ctx = {ctx_create, ctx_destroy};
+    return suite_main("xs_string", ops, sizeof(ops) / sizeof(ops[0]), &ctx,
+                      argc, argv);
+}
@@ -0,0 +1,324 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#include "xs_fmt.h"
+#include "xs_map.h"
+#include "xs_serial.h"
+#include "xs_slab.h"
+
+/* Regression tests, run by make check */
+
+#define QUEUE_LEN 64
+#define HANDOFFS 200000
+
+static struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    xs slot[QUEUE_LEN];
+    size_t head, tail;
+} queue = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER};
+
+static void *produce(void *unused)
+{
+    for (int i = 0; i < HANDOFFS; ++i)
+    {
+        xs s;
+        xs_grow(xs_newempty(&s), 100 + i % 900);
+        pthread_mutex_lock(&queue.lock);
+        while (queue.tail - queue.head == QUEUE_LEN)
+            pthread_cond_wait(&queue.cond, &queue.lock);
+        queue.slot[queue.tail++ % QUEUE_LEN] = s;
+        pthread_cond_broadcast(&queue.cond);
+        pthread_mutex_unlock(&queue.lock);
+    }
+    return NULL;
+}
+
+static void *consume(void *unused)
+{
+    for (int i = 0; i < HANDOFFS; ++i)
+    {
+        pthread_mutex_lock(&queue.lock);
+        while (queue.tail == queue.head)
+            pthread_cond_wait(&queue.cond, &queue.lock);
+        xs s = queue.slot[queue.head++ % QUEUE_LEN];
+        pthread_cond_broadcast(&queue.cond);
+        pthread_mutex_unlock(&queue.lock);
+        xs_free(&s);
+    }
+    return NULL;
+}
+
+/* Blocks freed by the consumer find their way back to the producer, and
+ * all chunks are returned once both threads are gone.
+ */
+static void test_slab_producer_consumer(void)
+{
+    pthread_t p, c;
+
+    xs_set_allocator(&xs_slab_allocator);
+    pthread_create(&p, NULL, produce, NULL);
+    pthread_create(&c, NULL, consume, NULL);
+    pthread_join(p, NULL);
+    pthread_join(c, NULL);
+    xs_set_allocator(NULL);
+
+    /* a few chunks per class cover the strings in flight */
+    assert(xs_slab_overflow.chunks <= 4 * XS_SLAB_CLASSES);
+    xs_slab_trim();
+    assert(xs_slab_overflow.chunks == 0);
+}
+
+xs *xs_test_tu_grow(xs *x, size_t len);
+
+/* The allocator and the scope arena of this translation unit are those of
+ * xs_test_tu.c as well: a string it allocates comes from this one's slab.
+ */
+static void test_shared_state(void)
+{
+    xs s;
+    xs_scope scope;
+
+    xs_set_allocator(&xs_slab_allocator);
+    size_t chunks = xs_slab_overflow.chunks;
+    xs_test_tu_grow(&s, 100);
+    assert(xs_is_ptr(&s) && !s.is_arena);
+    assert(xs_slab_overflow.chunks == chunks + 1);
+    assert(xs_slab_chunk(xs_data(&s))->owner == xs_slab_self());
+    xs_free(&s);
+    xs_set_allocator(NULL);
+
+    xs_scope_begin(&scope);
+    xs_test_tu_grow(&s, 100);
+    assert(s.is_arena);
+    xs_scope_end(&scope);
+}
+
+/* A slice that holds the last reference to its buffer, concatenated with
+ * itself as the prefix and as the suffix.
+ */
+static void test_concat_alias(void)
+{
+    for (int as_suffix = 0; as_suffix < 2; ++as_suffix)
+    {
+        xs parent, sl, abc;
+        char body[300], expect[603];
+
+        xs_new(&parent, "");
+        for (int i = 0; i < 40; ++i)
+            xs_concat(&parent, xs_tmp(""), xs_tmp("0123456789"));
+        xs_slice(&sl, &parent, 5, sizeof(body));
+        xs_free(&parent);
+        assert(xs_is_slice(&sl));
+        memcpy(body, xs_data(&sl), sizeof(body));
+        xs_new(&abc, "abc");
+
+        if (as_suffix)
+        {
+            xs_concat(&sl, &abc, &sl);
+            memcpy(expect, "abc", 3);
+            memcpy(expect + 3, body, sizeof(body));
+            memcpy(expect + 303, body, sizeof(body));
+        }
+        else
+        {
+            xs_concat(&sl, &sl, &abc);
+            memcpy(expect, body, sizeof(body));
+            memcpy(expect + 300, body, sizeof(body));
+            memcpy(expect + 600, "abc", 3);
+        }
+        assert(xs_size(&sl) == sizeof(expect));
+        assert(!memcmp(xs_data(&sl), expect, sizeof(expect)));
+        assert(xs_data(&sl)[sizeof(expect)] == 0);
+        xs_free(&sl);
+        xs_free(&abc);
+    }
+
+    /* in place, the operands move along with the string */
+    xs s;
+    xs_new(&s, "ab");
+    xs_concat(&s, &s, &s);
+    assert(!strcmp(xs_data(&s), "ababab"));
+    xs_free(&s);
+}
+
+/* Arguments that point into the string being appended to */
+static void test_appendf_alias(void)
+{
+    xs s;
+    xs_new(&s, "ab");
+    xs_appendf(&s, "%s-%s", xs_data(&s), xs_data(&s));
+    assert(!strcmp(xs_data(&s), "abab-ab"));
+    xs_free(&s);
+
+    /* growing moves the buffer */
+    char body[300];
+    memset(body, 'x', sizeof(body));
+    xs_new_len(&s, body, sizeof(body));
+    xs_appendf(&s, "%s%s", xs_data(&s), xs_data(&s));
+    assert(xs_size(&s) == 3 * sizeof(body));
+    assert(strspn(xs_data(&s), "x") == 3 * sizeof(body));
+    xs_free(&s);
+
+    /* a slice holding the last reference, through vsnprintf */
+    xs parent, sl;
+    xs_new(&parent, "");
+    for (int i = 0; i < 40; ++i)
+        xs_concat(&parent, xs_tmp(""), xs_tmp("0123456789"));
+    xs_slice(&sl, &parent, 5, 300);
+    xs_free(&parent);
+    assert(xs_is_slice(&sl));
+    memcpy(body, xs_data(&sl), sizeof(body));
+    xs_appendf(&sl, "|%.*s", (int)xs_size(&sl), xs_data(&sl));
+    assert(xs_size(&sl) == 601 && xs_data(&sl)[300] == '|');
+    assert(!memcmp(xs_data(&sl), body, 300));
+    assert(!memcmp(xs_data(&sl) + 301, body, 300));
+    xs_free(&sl);
+}
+
+static xs *map_key(xs *k, int i)
+{
+    char buf[16];
+    snprintf(buf, sizeof(buf), "key%d", i);
+    return xs_new(k, buf);
+}
+
+/* Removed keys leave no hole in the probe sequence of the others */
+static void test_map_remove(void)
+{
+    xs_map m;
+    xs k;
+    xs_map_init(&m);
+    for (int i = 0; i < 1000; ++i)
+        *xs_map_put(&m, map_key(&k, i)) = (void *)(intptr_t)(i + 1);
+    for (int i = 0; i < 1000; i += 2)
+    {
+        assert(xs_map_remove(&m, map_key(&k, i)));
+        assert(!xs_map_remove(&m, &k));
+    }
+    assert(m.count == 500);
+    for (int i = 0; i < 1000; ++i)
+    {
+        void **v = xs_map_get(&m, map_key(&k, i));
+        assert(i % 2 ? v && *v == (void *)(intptr_t)(i + 1) : !v);
+    }
+    xs_map_free(&m);
+}
+
+/* The ASCII mark must not land on the terminator of a full short string */
+static void test_utf8_full_short_string(void)
+{
+    xs s;
+    xs_new(&s, "0123456789abcdefghijklmnopqrstu");
+    assert(xs_size(&s) == SHORT_STRING_LEN && !xs_is_ptr(&s));
+    assert(xs_utf8_valid(&s));
+    assert(strlen(xs_data(&s)) == SHORT_STRING_LEN);
+    assert(xs_utf8_valid(&s));
+
+    /* shorter ones are marked and still terminated */
+    xs_new(&s, "ascii");
+    assert(xs_utf8_valid(&s) && s.flag2);
+    assert(strlen(xs_data(&s)) == 5);
+}
+
+/* Data left over after the last string fails the read */
+static void test_serial_trailing_bytes(void)
+{
+    xs v[2];
+    xs_new(&v[0], "first");
+    xs_new(&v[1], "a second string, long enough to be read as a slice");
+
+    for (int extra = 0; extra < 2; ++extra)
+    {
+        FILE *f = tmpfile();
+        size_t n;
+        assert(xs_write_array(fileno(f), v, 2));
+        xs_serial_header h;
+        rewind(f);
+        assert(fread(&h, sizeof(h), 1, f) == 1);
+        if (extra)
+        {
+            /* one more byte at the end of the data */
+            h.data_size++;
+            rewind(f);
+            fwrite(&h, sizeof(h), 1, f);
+            fseek(f, 0, SEEK_END);
+            fputc(0, f);
+        }
+        fflush(f);
+        lseek(fileno(f), 0, SEEK_SET);
+
+        xs *r = xs_read_array(fileno(f), &n);
+        assert(extra ? !r : r && n == 2);
+        if (r)
+        {
+            assert(xs_equal(&r[0], &v[0]) && xs_equal(&r[1], &v[1]));
+            xs_free(&r[0]);
+            xs_free(&r[1]);
+            free(r);
+        }
+        fclose(f);
+    }
+    xs_free(&v[0]);
+    xs_free(&v[1]);
+}
+
+/* xs_read_array of a file made of h and the sections given */
+static xs *serial_read(xs_serial_header h, const void *lengths,
+                       const void *data, size_t data_len, size_t *n)
+{
+    FILE *f = tmpfile();
+    memcpy(h.magic, XS_SERIAL_MAGIC, sizeof(h.magic));
+    fwrite(&h, sizeof(h), 1, f);
+    fwrite(lengths, 1, h.lengths_size, f);
+    fwrite(data, 1, data_len, f);
+    fflush(f);
+    lseek(fileno(f), 0, SEEK_SET);
+    xs *r = xs_read_array(fileno(f), n);
+    fclose(f);
+    return r;
+}
+
+/* Headers that do not match the file, and lengths cut off, fail the read */
+static void test_serial_bad_header(void)
+{
+    size_t n;
+    xs *r = serial_read((xs_serial_header){.count = 1, .lengths_size = 1,
+                                           .data_size = 6},
+                        "\x05", "abcde", 6, &n);
+    assert(r && n == 1 && !strcmp(xs_data(&r[0]), "abcde"));
+    xs_free(&r[0]);
+    free(r);
+
+    /* more data than the file holds, or than a string may */
+    assert(!serial_read((xs_serial_header){.count = 1, .lengths_size = 1,
+                                           .data_size = (uint64_t)1 << 40},
+                        "\x05", "abcde", 6, &n));
+    assert(!serial_read((xs_serial_header){.count = 1, .lengths_size = 1,
+                                           .data_size = (uint64_t)1 << 60},
+                        "\x05", "abcde", 6, &n));
+
+    /* the varint of the last length goes on past the lengths */
+    assert(!serial_read((xs_serial_header){.count = 1, .lengths_size = 1,
+                                           .data_size = 6},
+                        "\x85", "abcde", 6, &n));
+    assert(!serial_read((xs_serial_header){.count = 1, .lengths_size = 0,
+                                           .data_size = 1},
+                        "", "", 1, &n));
+}
+
+int main(int argc, char *argv[])
+{
+    test_concat_alias();
+    test_appendf_alias();
+    test_map_remove();
+    test_utf8_full_short_string();
+    test_serial_trailing_bytes();
+    test_serial_bad_header();
+    test_slab_producer_consumer();
+    test_shared_state();
+    printf("ok\n");
+    return 0;
+}
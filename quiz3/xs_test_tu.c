@@ -0,0 +1,7 @@
+#include "xs_slab.h"
+
+/* A second translation unit for xs_test, see test_shared_state */
+xs *xs_test_tu_grow(xs *x, size_t len)
+{
+    return xs_grow(xs_newempty(x), len);
+}